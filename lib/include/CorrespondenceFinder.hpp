@@ -7,6 +7,10 @@
 
 #pragma once
 
+#include <vector>
+
+#include "opencv2/core.hpp"
+
 #include "core/Definitions.hpp"
 
 #include "Definitions.hpp"
@@ -38,12 +42,45 @@ public:
      */
     Correspondences execute(const std::vector<core::FeatureVector>& sourceFeatureVectors,
             const std::vector<core::FeatureVector>& targetFeatureVectors) const;
-private:
-    /**
-     * Sorts correspondences by the first (source) correspondence index in-place.
+
+    /** 
+     * Same as above, but additionally reports the quality of each correspondence,
+     * measured as the gap between the distances of the best and the second best
+     * matching target feature vectors.
      * 
-     * @param correspondences The correspondences to sort in-place
+     * @param sourceFeatureVectors The source list of feature vectors
+     * @param targetFeatureVectors The target list of feature vectors
+     * @param matchQualities Output quality of each returned correspondence, a larger
+     *                       value indicates a more discriminative match
+     * @return The correspondences between the source and the target list of feature
+     *         vectors, sorted by source index
      */
-    void sortCorrespondences(Correspondences& correspondences) const;
-};
+    Correspondences execute(const std::vector<core::FeatureVector>& sourceFeatureVectors,
+            const std::vector<core::FeatureVector>& targetFeatureVectors,
+            std::vector<float>& matchQualities) const;
 
+    /** 
+     * Same as above, but each source feature vector is only matched against the
+     * target feature vectors whose keypoints lie within a search radius of where the
+     * source keypoint is predicted to be (example: where it was in the previous frame
+     * of a video).  A single target feature vector within reach is measured against
+     * the max possible distance instead of a second best match.
+     * 
+     * @param sourceFeatureVectors The source list of feature vectors
+     * @param predictedKeypoints Predicted target image position of each source
+     *                           feature vector
+     * @param targetFeatureVectors The target list of feature vectors
+     * @param targetKeypoints Target image position of each target feature vector
+     * @param searchRadius Max distance (in pixels) along each axis between the
+     *                     predicted position and a matching target keypoint
+     * @param matchQualities Output quality of each returned correspondence, a larger
+     *                       value indicates a more discriminative match
+     * @return The correspondences between the source and the target list of feature
+     *         vectors, sorted by source index
+     */
+    Correspondences execute(const std::vector<core::FeatureVector>& sourceFeatureVectors,
+            const std::vector<cv::Point>& predictedKeypoints,
+            const std::vector<core::FeatureVector>& targetFeatureVectors,
+            const std::vector<cv::Point>& targetKeypoints, int32_t searchRadius,
+            std::vector<float>& matchQualities) const;
+};
@@ -16,6 +16,9 @@ struct MatchingPoints {
     std::vector<cv::Point> fromPts;
     // Respective points in the second (target) image
     std::vector<cv::Point> toPts;
+    // Optional quality score of each match where higher is more reliable, empty
+    // if unknown
+    std::vector<float> qualities;
 public:
     /**
      * Simple constructor that validates and directly assigns the two data members
@@ -37,6 +40,18 @@ public:
     MatchingPoints(const std::vector<cv::Point>& sourceKeypoints,
             const std::vector<cv::Point>& targetKeypoints,
             const Correspondences& correspondences);
+    /**
+     * Same as above, but additionally stores a quality score for each correspondence.
+     * 
+     * @param sourceKeypoints The list of keypoints detected in the first (source) image
+     * @param targetKeypoints The list of keypoints detected in the second (target) image
+     * @param correspondences The correspondences between the aforementioned lists of keypoints
+     * @param matchQualities The quality score of each correspondence
+     */
+    MatchingPoints(const std::vector<cv::Point>& sourceKeypoints,
+            const std::vector<cv::Point>& targetKeypoints,
+            const Correspondences& correspondences,
+            const std::vector<float>& matchQualities);
     MatchingPoints() {};
 private:
     /**
@@ -6,14 +6,147 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "opencv2/core.hpp"
 
 class SceneAugmenterPri;
 
 class SceneAugmenter {
+public:
+    /** 
+     * How the work of the calls is spread over the cores of the machine.
+     */
+    enum class SchedulingPolicy {
+        // Each call runs the stages of the pipeline in parallel, to augment a single
+        // target image as fast as possible
+        LATENCY,
+        // Each call runs the stages of the pipeline on a single thread, while
+        // executeBatch and executeAsync augment as many target images at once as there
+        // are cores, to augment a stream of target images as fast as possible
+        THROUGHPUT
+    };
+
+    /** 
+     * Diagnostics of a single call to execute, describing how well the source object
+     * was found and how long each stage of the pipeline took.
+     */
+    struct Diagnostics {
+        // Number of keypoints detected in the source and target images
+        uint32_t numSourceKeypoints = 0u;
+        uint32_t numTargetKeypoints = 0u;
+        // Number of keypoint correspondences between the source and target images
+        uint32_t numCorrespondences = 0u;
+        // Number of instances of the source object found
+        uint32_t numInstances = 0u;
+        // Number of correspondences consistent with the transformations found, and
+        // their fraction of all correspondences
+        uint32_t numInliers = 0u;
+        float inlierRatio = 0.0f;
+        // Number of RANSAC iterations run, out of the allowed budget, summed over all
+        // instances searched for
+        uint32_t numIters = 0u;
+        uint32_t maxIters = 0u;
+        // Indicator that a transformation was found
+        bool isTransformationFound = false;
+        // Indicator that the sanity checks rejected the augmentation produced by a
+        // transformation found
+        bool isAugmentationRejected = false;
+        // Tracking mode only: indicator that the instances were tracked from the
+        // previous call instead of searched for in the whole target image
+        bool isTracked = false;
+        // Wall time (in milliseconds) of each stage of the pipeline and of the whole call
+        double targetDescriptionTimeMs = 0.0;
+        double correspondenceTimeMs = 0.0;
+        double fitTimeMs = 0.0;
+        double augmentationTimeMs = 0.0;
+        double totalTimeMs = 0.0;
+    };
+
+    /** 
+     * Sparse result of a single call to executeOverlay: the replacement object
+     * warped onto the only region of the target image augmentation would change,
+     * to be composited onto the target image by the caller.
+     */
+    struct Overlay {
+        // Region of the target image covered by the instances found, empty if none
+        // was found
+        cv::Rect region;
+        // 3-channel BGR uint8 image of the region dimensions, the replacement object
+        // as augmentation would write it, 0 outside of the mask
+        cv::Mat patch;
+        // 1-channel uint8 image of the region dimensions, 255 where the patch
+        // replaces the target image and 0 where the target image shows through
+        cv::Mat mask;
+    };
+
+    /** 
+     * Result of a single call to locate: where an instance of the source object
+     * lies in the target image.
+     */
+    struct Location {
+        // Indicator that the instance was found and passes the sanity checks that
+        // gate augmentation
+        bool isValid = false;
+        // Homography mapping source image coordinates onto target image coordinates,
+        // the identity if no instance was found
+        cv::Matx33f homography = cv::Matx33f::eye();
+        // Outer corners of the source image, (0, 0), (width, 0), (width, height) and
+        // (0, height), projected onto the target image, empty if no instance was found
+        std::vector<cv::Point2f> corners;
+        // Number of correspondences consistent with the homography
+        uint32_t numInliers = 0u;
+    };
+
+    /** 
+     * Result of a single call to executeAsync.
+     */
+    struct AsyncResult {
+        // Indicator that the call was cancelled before completing, in which case the
+        // output image is empty
+        bool isCancelled = false;
+        // The augmented target image, or a copy of the target image if the algorithm
+        // fails, same as execute
+        cv::Mat outputImage;
+        Diagnostics diagnostics;
+        // Callback only: error raised by the call, null if none, in which case the
+        // output image is empty (the future returned by executeAsync raises it instead)
+        std::exception_ptr error;
+    };
+
+    /** 
+     * Cancels calls to executeAsync.  Copies share the same state, so cancelling any
+     * copy cancels every call made with any of them.
+     */
+    class CancellationToken {
+    private:
+        std::shared_ptr<std::atomic<bool>> isCancelledFlag;
+    public:
+        /** 
+         * Builds a new token, not cancelled.
+         */
+        CancellationToken();
+
+        /** 
+         * Cancels the calls made with this token: those that have not started are
+         * skipped, and those in progress stop before augmenting the target image.
+         */
+        void cancel() const;
+
+        /** 
+         * Checks whether the token was cancelled.
+         *
+         * @return Indicator that the token was cancelled
+         */
+        bool isCancelled() const;
+    };
 public:
     /** 
      * Builds a new SceneAugmenter using the given model path.
@@ -45,9 +178,73 @@ public:
      */
     void setReplacementImage(const cv::Mat& newReplacementImage);
 
+    /** 
+     * Same as above, but (re)sets several images of objects to replace the source
+     * image with, each producing its own output in subsequent calls to execute
+     * from a single search for the source object.  Calls to execute producing
+     * a single output use the first one.
+     *
+     * @param newReplacementImages New images of the objects to use as replacement to
+     *                             the source object, at least one, same requirements
+     *                             as above
+     */
+    void setReplacementImages(const std::vector<cv::Mat>& newReplacementImages);
+
+    /** 
+     * (Re)sets the max number of instances of the source object to search for and
+     * replace in subsequent calls to execute on scene images, 1 by default.
+     *
+     * @param newMaxNumInstances New max number of instances, must be at least 1
+     */
+    void setMaxNumInstances(uint32_t newMaxNumInstances);
+
+    /** 
+     * (Re)sets how far, in pixels, any corner of a replaced instance may move from
+     * one call to execute to the next while the previous warp of the replacement
+     * image is reused instead of being computed again, 0 by default so that only
+     * identical placements are reused.  Raising it speeds up augmentation of video
+     * from a fixed camera, at the cost of instances lagging behind by up to the
+     * tolerance.
+     *
+     * @param newMaxCornerDisplacement New tolerance in pixels, must not be negative
+     */
+    void setWarpCacheTolerance(float newMaxCornerDisplacement);
+
+    /** 
+     * Enables or disables tracking mode, off by default, for consecutive frames of
+     * a video.  In tracking mode, the instances found by one call to execute are
+     * tracked into the next: only the keypoints consistent with each instance are
+     * matched, against the target keypoints near where they are predicted to be, and
+     * each instance is refit from these matches.  The whole target image is searched
+     * again at every keyframe, and as soon as any instance keeps too few inliers.
+     * Instances appearing in between keyframes are only found at the next one.  Calls
+     * to execute are serialized in tracking mode, and must be made in frame order.
+     *
+     * @param isEnabled Indicator that tracking mode is enabled
+     */
+    void setTrackingMode(bool isEnabled);
+
+    /** 
+     * (Re)sets the number of calls to execute from one full search of the target
+     * image to the next in tracking mode, 10 by default.
+     *
+     * @param newKeyframeInterval New keyframe interval, must be at least 1, where 1
+     *                            searches every target image
+     */
+    void setKeyframeInterval(uint32_t newKeyframeInterval);
+
+    /** 
+     * (Re)sets the min number of inliers each instance must keep to be tracked further
+     * in tracking mode, 20 by default.  Below it, the whole target image is searched.
+     *
+     * @param newMinNumInliers New min number of inliers, must be at least 4
+     */
+    void setMinTrackedInliers(uint32_t newMinNumInliers);
+
     /** 
      * Attempts to replace the source object with the replacement object in
-     * the target image, if it exists. If the source object is not found or if
+     * the target image, if it exists (every instance of it found, up to the
+     * max number of instances). If the source object is not found or if
      * the algorithm fails, a deep copy of the input image will be returned
      * effectively not augmenting the image.
      *
@@ -59,6 +256,209 @@ public:
      */
     cv::Mat execute(const cv::Mat& targetImage) const;
 
+    /** 
+     * Same as above, but also reports diagnostics of the call.
+     *
+     * @param targetImage The aforementioned target image
+     * @param diagnostics Output diagnostics of the call
+     * @return The augmented target image, or a copy of the target image
+     *         if the algorithm fails
+     */
+    cv::Mat execute(const cv::Mat& targetImage, Diagnostics& diagnostics) const;
+
+    /** 
+     * Same as above, but writes the augmented image into a caller-owned output image
+     * instead of allocating a new one.  The output image is only reallocated if it
+     * is not a 3-channel BGR uint8 image of the target image dimensions.  The output
+     * image may be the target image itself, in which case only the pixels the
+     * replacement object lands on are written, and none if the algorithm fails.
+     *
+     * @param targetImage The aforementioned target image
+     * @param outputImage Output augmented target image, or copy of the target image
+     *                    if the algorithm fails
+     */
+    void execute(const cv::Mat& targetImage, cv::Mat& outputImage) const;
+
+    /** 
+     * Same as above, but also reports diagnostics of the call.
+     *
+     * @param targetImage The aforementioned target image
+     * @param outputImage Output augmented target image, or copy of the target image
+     *                    if the algorithm fails
+     * @param diagnostics Output diagnostics of the call
+     */
+    void execute(const cv::Mat& targetImage, cv::Mat& outputImage,
+            Diagnostics& diagnostics) const;
+
+    /** 
+     * Same as execute, but instead of writing a whole augmented image, only returns
+     * the warped replacement object with its mask and region in the target image.
+     * Copying the patch onto the region of a 3-channel BGR copy of the target image
+     * through the mask gives the output of execute.
+     *
+     * @param targetImage The aforementioned target image
+     * @param overlay Output overlay, with an empty region if the algorithm fails
+     */
+    void executeOverlay(const cv::Mat& targetImage, Overlay& overlay) const;
+
+    /** 
+     * Same as above, but also reports diagnostics of the call.
+     *
+     * @param targetImage The aforementioned target image
+     * @param overlay Output overlay, with an empty region if the algorithm fails
+     * @param diagnostics Output diagnostics of the call
+     */
+    void executeOverlay(const cv::Mat& targetImage, Overlay& overlay,
+            Diagnostics& diagnostics) const;
+
+    /** 
+     * Only searches for the source object in the target image, without any
+     * augmentation, so the replacement image need not be set.
+     *
+     * @param targetImage The aforementioned target image
+     * @return Location of the first instance of the source object found, invalid
+     *         if the algorithm fails
+     */
+    Location locate(const cv::Mat& targetImage) const;
+
+    /** 
+     * Same as above, but also reports diagnostics of the call.
+     *
+     * @param targetImage The aforementioned target image
+     * @param diagnostics Output diagnostics of the call
+     * @return Location of the first instance of the source object found, invalid
+     *         if the algorithm fails
+     */
+    Location locate(const cv::Mat& targetImage, Diagnostics& diagnostics) const;
+
+    /** 
+     * Same as above, but returns the location of every instance found, up to the max
+     * number of instances.
+     *
+     * @param targetImage The aforementioned target image
+     * @param locations Output location of each instance found, empty if none was
+     * @param diagnostics Output diagnostics of the call
+     */
+    void locate(const cv::Mat& targetImage, std::vector<Location>& locations,
+            Diagnostics& diagnostics) const;
+
+    /** 
+     * Same as execute, but augments the target image with every replacement image,
+     * searching for the source object only once.  Each output image is reused as
+     * described above.
+     *
+     * @param targetImage The aforementioned target image
+     * @param outputImages Output augmented target image for each replacement image,
+     *                     in the order they were set
+     */
+    void execute(const cv::Mat& targetImage, std::vector<cv::Mat>& outputImages) const;
+
+    /** 
+     * Same as above, but also reports diagnostics of the call.
+     *
+     * @param targetImage The aforementioned target image
+     * @param outputImages Output augmented target image for each replacement image,
+     *                     in the order they were set
+     * @param diagnostics Output diagnostics of the call
+     */
+    void execute(const cv::Mat& targetImage, std::vector<cv::Mat>& outputImages,
+            Diagnostics& diagnostics) const;
+
+    /** 
+     * Same as executeOverlay, but warps every replacement image, searching for the
+     * source object only once.
+     *
+     * @param targetImage The aforementioned target image
+     * @param overlays Output overlay for each replacement image, in the order they
+     *                 were set
+     */
+    void executeOverlay(const cv::Mat& targetImage, std::vector<Overlay>& overlays) const;
+
+    /** 
+     * Same as above, but also reports diagnostics of the call.
+     *
+     * @param targetImage The aforementioned target image
+     * @param overlays Output overlay for each replacement image, in the order they
+     *                 were set
+     * @param diagnostics Output diagnostics of the call
+     */
+    void executeOverlay(const cv::Mat& targetImage, std::vector<Overlay>& overlays,
+            Diagnostics& diagnostics) const;
+
+    /** 
+     * Augments a stream of target images (example: the frames of a video) as execute
+     * would augment each of them, but pipelined: decoding, description, matching,
+     * fitting, augmentation and encoding each run on their own thread, on different
+     * frames at once, connected by bounded queues.  In throughput mode, description,
+     * matching and fitting instead run together on one thread per core, each thread
+     * on its own frames, and augmentation still follows frame order.  Each callback
+     * is only called from a single thread, in frame order.  Tracking mode does not
+     * apply, since a frame is described before the previous one is fit.  Errors raised
+     * by the callbacks or by any stage stop the whole pipeline and are rethrown.
+     *
+     * @param readFrame Callback that decodes the target image of the given frame index
+     *                  into the given image, or returns false past the last frame
+     * @param writeFrame Callback that consumes the augmented target image of the given
+     *                   frame index
+     * @param queueDepth Max number of frames waiting in each queue in between two
+     *                   consecutive stages, must be at least 1.  The 6 stages of
+     *                   latency mode are connected by 5 queues, so up to 5 times that
+     *                   many frames wait in total.  In throughput mode, each search
+     *                   thread has its own queue on either side, so up to 2 times the
+     *                   number of cores plus 1 times that many frames wait in total
+     */
+    void executeBatch(const std::function<bool(uint32_t, cv::Mat&)>& readFrame,
+            const std::function<void(uint32_t, const cv::Mat&)>& writeFrame,
+            uint32_t queueDepth = 2u) const;
+
+    /** 
+     * (Re)sets the scheduling policy of subsequent calls, latency by default.  Both
+     * policies give identical results, given the same calls in the same order.  Waits
+     * for the calls to executeAsync already submitted to complete, so it must not be
+     * called from a completion callback.
+     *
+     * @param newSchedulingPolicy New scheduling policy
+     */
+    void setSchedulingPolicy(SchedulingPolicy newSchedulingPolicy);
+
+    /** 
+     * (Re)sets the number of threads of the pool owned by this object that runs the
+     * calls to executeAsync, by default 2 in latency mode, where each call still runs
+     * the stages of the pipeline in parallel so a few threads suffice to overlap calls,
+     * and one per core in throughput mode.  Waits for the calls already submitted to
+     * complete, so it must not be called from a completion callback.
+     *
+     * @param newNumThreads New number of threads, must be at least 1
+     */
+    void setNumAsyncThreads(uint32_t newNumThreads);
+
+    /** 
+     * Same as execute, but returns at once and runs on the thread pool of this object,
+     * so that many calls may be in flight at once.  The target image is not copied, so
+     * its data must not be modified until the call completes.  Destroying this object
+     * waits for every call submitted to complete.
+     *
+     * @param targetImage The aforementioned target image
+     * @param cancellationToken Optional token to cancel the call with
+     * @return Future result of the call, which raises the error of the call if any
+     */
+    std::future<AsyncResult> executeAsync(const cv::Mat& targetImage,
+            const CancellationToken& cancellationToken = CancellationToken()) const;
+
+    /** 
+     * Same as above, but calls a callback on completion instead of returning a future.
+     *
+     * @param targetImage The aforementioned target image
+     * @param onComplete Callback called with the result of the call, from a thread of
+     *                   the thread pool.  Errors it raises are ignored, and it must
+     *                   not destroy the last copy of this object, which waits for
+     *                   the thread calling it
+     * @param cancellationToken Optional token to cancel the call with
+     */
+    void executeAsync(const cv::Mat& targetImage,
+            const std::function<void(const AsyncResult&)>& onComplete,
+            const CancellationToken& cancellationToken = CancellationToken()) const;
+
 private:
     std::shared_ptr<SceneAugmenterPri> sceneAugmenterPri;
 };
@@ -4,16 +4,29 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "opencv2/core.hpp"
 
+#include "shared/BoundedQueue.hpp"
+#include "shared/ThreadPool.hpp"
+
 #include "core/Definitions.hpp"
 #include "core/KeypointDetector.hpp"
+#include "core/Transformation.hpp"
+#include "core/homography/Evaluator.hpp"
 
 #include "CorrespondenceFinder.hpp"
 #include "Definitions.hpp"
+#include "MatchingPoints.hpp"
+#include "SceneAugmenter.hpp"
 #include "SceneFeatureExtractor.hpp"
 #include "TransformationFitter.hpp"
 
@@ -38,7 +51,111 @@ private:
                 featureVectors(_featureVectors) {};
         ImageDescription() {};
     };
+
+    /**
+     * Warp of the last augmentation by each replacement image, reused by the next one
+     * if the instances barely moved, along with the mutex that guards them against
+     * concurrent calls to execute.
+     */
+    struct GuardedWarpCaches {
+        std::vector<core::homography::Evaluator::WarpCache> warpCaches;
+        float maxCornerDisplacement = 0.0f;
+        std::mutex mutex;
+    };
+
+    /**
+     * Instance of the source object found in the previous call to execute, tracked
+     * into the next one.
+     */
+    struct TrackedInstance {
+        core::Transformation transformation;
+        // Indices of the source keypoints consistent with the transformation
+        std::vector<uint32_t> sourceIndices;
+    };
+
+    /**
+     * State of the tracking mode carried from one call to execute to the next, along
+     * with the mutex that guards it against concurrent calls to execute.
+     */
+    struct GuardedTrackingState {
+        bool isEnabled = false;
+        uint32_t keyframeInterval = 10u;
+        uint32_t minNumInliers = 20u;
+        // Instances found in the previous call, empty to force a full search
+        std::vector<TrackedInstance> instances;
+        // Number of calls tracked since the last full search
+        uint32_t numTrackedFrames = 0u;
+        std::mutex mutex;
+    };
+
+    /**
+     * Intermediate results of the search for the source object in a target image,
+     * handed from one stage of the pipeline to the next.
+     */
+    struct TargetSearch {
+        ImageDescription targetImageDescription;
+        Correspondences correspondences;
+        MatchingPoints matchingPoints;
+        std::vector<TransformationFitter::FitResult> fitResults;
+    };
+
+    /**
+     * A single frame going through the stages of executeBatch.
+     */
+    struct BatchFrame {
+        uint32_t iFrame = 0u;
+        cv::Mat targetImage;
+        TargetSearch search;
+        SceneAugmenter::Diagnostics diagnostics;
+        cv::Mat outputImage;
+    };
+    using BatchQueue = shared::BoundedQueue<std::unique_ptr<BatchFrame>>;
+
+    /**
+     * Stage of executeBatch, run by several threads that take turns on the frames.
+     */
+    struct BatchStage {
+        std::function<bool(BatchFrame&)> processFrame;
+        uint32_t numThreads;
+    };
+
+    /**
+     * Restricts the OpenMP parallel regions started by the current thread to that
+     * thread alone, for the lifetime of the object, if requested.
+     */
+    class SerialKernelsGuard {
+    private:
+        int32_t prevMaxNumThreads;
+    public:
+        SerialKernelsGuard(bool isSerial);
+        ~SerialKernelsGuard();
+
+        SerialKernelsGuard(const SerialKernelsGuard&) = delete;
+        SerialKernelsGuard& operator=(const SerialKernelsGuard&) = delete;
+    };
+
+    /**
+     * Thread pool running the calls to executeAsync, created on the first call, along
+     * with the mutex that guards it against concurrent calls.
+     */
+    struct GuardedThreadPool {
+        std::unique_ptr<shared::ThreadPool> threadPool;
+        // Number of threads of the pool, 0 to pick it from the scheduling policy
+        uint32_t numThreads = 0u;
+        std::mutex mutex;
+    };
 private:
+    // Tracking mode only: max distance (in pixels) along each axis a keypoint may move
+    // between consecutive calls to execute
+    static constexpr int32_t trackingSearchRadius = 24;
+    // Tracking mode only: RANSAC iteration budget of the refit from the tracked
+    // keypoints, which are mostly inliers
+    static constexpr uint32_t trackingMaxIters = 200u;
+
+    // Latency mode only: number of threads running the calls to executeAsync unless
+    // set, few since each call already runs in parallel
+    static constexpr uint32_t defaultNumAsyncThreads = 2u;
+
     /**
      * The core modules that facilitate SceneAugmentation.
      */
@@ -46,25 +163,122 @@ private:
     SceneFeatureExtractor sceneFeatureExtractor;
     CorrespondenceFinder correspondenceFinder;
     TransformationFitter transformationFitter;
+    TransformationFitter trackingFitter;
 
     /**
      * Persistent data structures that store precomputed information of both
      * the source and replacement images.
      */
     ImageDescription sourceImageDescription;
-    cv::Mat replacementImageFloat;
+    std::vector<cv::Mat> replacementImagesColor;
+    // Pyramid of each replacement image scaled to the source image dimensions, built
+    // once both the source and replacement images are set
+    std::vector<std::vector<cv::Mat>> replacementPyramids;
+
+    // Max number of instances of the source object to search for in target images
+    uint32_t maxNumInstances = 1u;
+
+    SceneAugmenter::SchedulingPolicy schedulingPolicy =
+            SceneAugmenter::SchedulingPolicy::LATENCY;
+
+    // Held by pointer so that the object stays movable
+    std::unique_ptr<GuardedWarpCaches> guardedWarpCaches;
+    std::unique_ptr<GuardedTrackingState> guardedTrackingState;
+    // Declared last so that it is destroyed first, while the calls it still runs can
+    // use everything else
+    std::unique_ptr<GuardedThreadPool> guardedThreadPool;
 public:
     /** 
      * Internal public interface, see SceneAugmenter.hpp for full documentation
      */
     SceneAugmenterPri(const std::string& modelPath) :
             keypointDetector{}, sceneFeatureExtractor{modelPath},
-            correspondenceFinder{}, transformationFitter{} {};
+            correspondenceFinder{}, transformationFitter{buildTransformationFitterParams()},
+            trackingFitter{buildTrackingFitterParams()},
+            guardedWarpCaches{new GuardedWarpCaches()},
+            guardedTrackingState{new GuardedTrackingState()},
+            guardedThreadPool{new GuardedThreadPool()} {};
 
     void setSourceImage(const cv::Mat& newSourceImage);
     void setReplacementImage(const cv::Mat& newReplacementImage);
+    void setReplacementImages(const std::vector<cv::Mat>& newReplacementImages);
+    void setMaxNumInstances(uint32_t newMaxNumInstances);
+    void setWarpCacheTolerance(float newMaxCornerDisplacement);
+    void setTrackingMode(bool isEnabled);
+    void setKeyframeInterval(uint32_t newKeyframeInterval);
+    void setMinTrackedInliers(uint32_t newMinNumInliers);
+    void executeBatch(const std::function<bool(uint32_t, cv::Mat&)>& readFrame,
+            const std::function<void(uint32_t, const cv::Mat&)>& writeFrame,
+            uint32_t queueDepth) const;
+    void setNumAsyncThreads(uint32_t newNumThreads);
+    void setSchedulingPolicy(SceneAugmenter::SchedulingPolicy newSchedulingPolicy);
+    std::future<SceneAugmenter::AsyncResult> executeAsync(const cv::Mat& targetImage,
+            const SceneAugmenter::CancellationToken& cancellationToken) const;
+    void executeAsync(const cv::Mat& targetImage,
+            const std::function<void(const SceneAugmenter::AsyncResult&)>& onComplete,
+            const SceneAugmenter::CancellationToken& cancellationToken) const;
     cv::Mat execute(const cv::Mat& targetImage) const;
+    cv::Mat execute(const cv::Mat& targetImage, SceneAugmenter::Diagnostics& diagnostics) const;
+    void execute(const cv::Mat& targetImage, cv::Mat& outputImage) const;
+    void execute(const cv::Mat& targetImage, cv::Mat& outputImage,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+    void executeOverlay(const cv::Mat& targetImage, SceneAugmenter::Overlay& overlay) const;
+    void executeOverlay(const cv::Mat& targetImage, SceneAugmenter::Overlay& overlay,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+    SceneAugmenter::Location locate(const cv::Mat& targetImage) const;
+    SceneAugmenter::Location locate(const cv::Mat& targetImage,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+    void locate(const cv::Mat& targetImage, std::vector<SceneAugmenter::Location>& locations,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+    void execute(const cv::Mat& targetImage, std::vector<cv::Mat>& outputImages) const;
+    void execute(const cv::Mat& targetImage, std::vector<cv::Mat>& outputImages,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+    void executeOverlay(const cv::Mat& targetImage,
+            std::vector<SceneAugmenter::Overlay>& overlays) const;
+    void executeOverlay(const cv::Mat& targetImage,
+            std::vector<SceneAugmenter::Overlay>& overlays,
+            SceneAugmenter::Diagnostics& diagnostics) const;
 private:
+    /** 
+     * Builds the params of the TransformationFitter used by the pipeline.
+     * 
+     * @return The aforementioned params
+     */
+    static TransformationFitter::Params buildTransformationFitterParams();
+
+    /** 
+     * Builds the params of the TransformationFitter that refits tracked instances.
+     * 
+     * @return The aforementioned params
+     */
+    static TransformationFitter::Params buildTrackingFitterParams();
+
+    /** 
+     * Finds the matching points consistent with a transformation, within the
+     * inlier threshold of the fit.
+     * 
+     * @param matchingPoints The matching points to check
+     * @param transformation A valid transformation
+     * @return Index of each consistent matching point
+     */
+    static std::vector<uint32_t> findInliers(const MatchingPoints& matchingPoints,
+            const core::Transformation& transformation);
+
+    /** 
+     * Measures the wall time elapsed since the given start time.
+     * 
+     * @param startTime The aforementioned start time
+     * @return The elapsed time in milliseconds
+     */
+    static double getElapsedTimeMs(const std::chrono::steady_clock::time_point& startTime);
+
+    /** 
+     * Gets the number of cores of the machine.
+     * 
+     * @return The aforementioned number of cores, at least 1
+     */
+    static uint32_t getNumCores();
+
     /** 
      * Verifies that the input image has the proper properties required by the
      * algorithm.
@@ -83,15 +297,171 @@ private:
     ImageDescription buildImageDescription(const cv::Mat& imageToDescribe) const;
 
     /** 
-     * Augments the persistent replacement image on to the targetImage using a given
-     * transformation.  The replacement image will be rescaled to fit the source image
-     * dimensions
+     * Verifies that the replacement images are set, along with the source image.
+     */
+    void validateReplacementImages() const;
+
+    /** 
+     * Finds the instances of the source object in a target image, the analysis half
+     * of the pipeline shared by execute, executeOverlay and locate.  In tracking mode,
+     * the instances of the previous call are tracked instead, unless a keyframe is
+     * due or tracking fails.  Fills in all diagnostics but the augmentation and total
+     * times.
+     * 
+     * @param targetImage The image to search
+     * @param diagnostics Output diagnostics of the search
+     * @return The fit of each instance found
+     */
+    std::vector<TransformationFitter::FitResult> findInstances(const cv::Mat& targetImage,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Searches the whole target image for the instances of the source object, see
+     * findInstances.
+     * 
+     * @param targetImage The image to search
+     * @param diagnostics Output diagnostics of the search
+     * @param trackedInstances Optional output instances found, to be tracked into the
+     *                         next call
+     * @return The fit of each instance found
+     */
+    std::vector<TransformationFitter::FitResult> detectInstances(const cv::Mat& targetImage,
+            SceneAugmenter::Diagnostics& diagnostics,
+            std::vector<TrackedInstance>* trackedInstances = nullptr) const;
+
+    /** 
+     * Describes the target image, the first stage of the search for the source object.
+     * 
+     * @param targetImage The image to search
+     * @param search Output search, whose target image description is set
+     * @param diagnostics Output diagnostics of the stage
+     */
+    void describeTarget(const cv::Mat& targetImage, TargetSearch& search,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Matches the source keypoints against the target keypoints, the second stage of
+     * the search for the source object.
+     * 
+     * @param search The search, whose correspondences and matching points are set
+     * @param diagnostics Output diagnostics of the stage
+     */
+    void matchTarget(TargetSearch& search, SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Fits the instances of the source object to the matching points, the last stage
+     * of the search for the source object.
+     * 
+     * @param targetSize Dimensions of the target image
+     * @param search The search, whose fits are set
+     * @param diagnostics Output diagnostics of the stage and of the fits
+     */
+    void fitTarget(const cv::Size& targetSize, TargetSearch& search,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Runs a single call to executeAsync, on a thread of the thread pool.
+     * 
+     * @param targetImage The image to augment
+     * @param cancellationToken Token checked before each half of the pipeline
+     * @param result Output result of the call
+     */
+    void runAsync(const cv::Mat& targetImage,
+            const SceneAugmenter::CancellationToken& cancellationToken,
+            SceneAugmenter::AsyncResult& result) const;
+
+    /** 
+     * Runs a thread of a stage of executeBatch until the end of the stream, or until
+     * the pipeline is cancelled.
+     * 
+     * @param inputQueues Queues the frames are popped from in turn, or none for the
+     *                    first stage, which creates the frames in order
+     * @param outputQueues Queues the frames are pushed to in turn, or none for the
+     *                     last stage
+     * @param processFrame Processing of the stage, which returns false to end the
+     *                     stream at the given frame
+     * @param isCancelled Flag raised to stop the whole pipeline
+     */
+    static void runBatchStage(const std::vector<BatchQueue*>& inputQueues,
+            const std::vector<BatchQueue*>& outputQueues,
+            const std::function<bool(BatchFrame&)>& processFrame,
+            const std::atomic<bool>& isCancelled);
+
+    /** 
+     * Tracks the instances of the previous call into the target image, by matching
+     * the keypoints consistent with each instance only against the target keypoints
+     * near where the instance predicts them, and refitting the instance from these
+     * matches, see findInstances.
+     * 
+     * @param targetImage The image to search
+     * @param minNumInliers Min number of inliers of each refit instance
+     * @param trackedInstances Instances of the previous call, replaced by the refit
+     *                         instances if tracking succeeds
+     * @param diagnostics Output diagnostics of the search
+     * @return The fit of each instance, or none if any instance was lost
+     */
+    std::vector<TransformationFitter::FitResult> trackInstances(const cv::Mat& targetImage,
+            uint32_t minNumInliers, std::vector<TrackedInstance>& trackedInstances,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Fills in the diagnostics describing the instances found.
+     * 
+     * @param fitResults The fit of each instance found
+     * @param targetSize Dimensions of the target image
+     * @param numTargetKeypoints Number of keypoints described in the target image
+     * @param numCorrespondences Number of correspondences the fits were performed on
+     * @param diagnostics Output diagnostics
+     */
+    void fillFitDiagnostics(const std::vector<TransformationFitter::FitResult>& fitResults,
+            const cv::Size& targetSize, uint32_t numTargetKeypoints,
+            uint32_t numCorrespondences, SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Finds the instances of the source object in a target image to augment it, see
+     * findInstances.
+     * 
+     * @param targetImage The image to search
+     * @param diagnostics Output diagnostics of the search
+     * @return The transformation of each instance found
+     */
+    std::vector<core::Transformation> findInstancesToAugment(const cv::Mat& targetImage,
+            SceneAugmenter::Diagnostics& diagnostics) const;
+
+    /** 
+     * Rebuilds the pyramid of each replacement image scaled to fit the source image
+     * dimensions, if both the source and replacement images are set, along with
+     * an empty warp cache for each.
+     */
+    void buildReplacementPyramids();
+
+    /** 
+     * Augments a persistent replacement image on to a color uint8 image in place
+     * using given transformations, one per instance of the source object.  The
+     * replacement image is sampled from its pyramid, rescaled to fit the source
+     * image dimensions, through its warp cache
+     * 
+     * @param image The image to perform augmentation on, in place
+     * @param transformations The transformations which mathematically describe the
+     *                        augmentation process via transformation matrices
+     * @param iReplacement Index of the replacement image
+     */
+    void augment(cv::Mat& image, const std::vector<core::Transformation>& transformations,
+            uint32_t iReplacement) const;
+
+    /** 
+     * Same as above, but only warps the replacement image into an overlay instead of
+     * augmenting an image.
      * 
-     * @param targetImage The image to perform augmentation on
-     * @param transformation The transformation which mathematically describes the
-     *                       augmentation process via a transformation matrix
-     * @return The augmented image
+     * @param imageSize Dimensions of the image to augment
+     * @param transformations The transformations which mathematically describe the
+     *                        augmentation process via transformation matrices
+     * @param iReplacement Index of the replacement image
+     * @param overlay Output overlay, with an empty region if no augmentation is
+     *                possible
      */
-    cv::Mat augment(const cv::Mat& targetImage, const core::Transformation& transformation) const;
+    void warpOverlay(const cv::Size& imageSize,
+            const std::vector<core::Transformation>& transformations,
+            uint32_t iReplacement, SceneAugmenter::Overlay& overlay) const;
 };
 
@@ -5,22 +5,211 @@
 
 #pragma once
 
+#include <array>
 #include <vector>
 
 #include "opencv2/core.hpp"
 
+#include "shared/RandomNumberGenerator.hpp"
+
 #include "core/Definitions.hpp"
 #include "core/Transformation.hpp"
+#include "core/homography/Definitions.hpp"
+#include "core/homography/InlierCounter.hpp"
 
 #include "MatchingPoints.hpp"
 
 class TransformationFitter {
+public:
+    // Max number of consecutive hypotheses a single thread generates and verifies
+    // together
+    static constexpr uint32_t MAX_ITERS_PER_BATCH = 64u;
+
+    /**
+     * Strategies used to select the minimal subsets of matching points that
+     * hypotheses are built from.
+     */
+    enum class Sampler {
+        // Uniformly random subsets of all matching points
+        UNIFORM,
+        // Subsets drawn from a progressively growing set of the best quality matches
+        PROSAC,
+        // Subsets drawn from the target image neighborhood of a random match
+        NAPSAC
+    };
+
+    /**
+     * Params that control the behavior of Transformation generation.
+     */
+    struct Params {
+        // Hard cap on the number of RANSAC hypotheses generated per fit
+        uint32_t maxIters = 50000u;
+        uint32_t minNonTrivialInliers = 2u;
+        float epsilon = 3.0f;
+        // Required probability of having drawn at least one outlier-free sample
+        // before terminating early, 1.0f disables early termination
+        float confidence = 0.99f;
+        // Seed of the random sampling, fits with the same seed on the same matches
+        // give identical results regardless of the number of threads
+        uint64_t seed = 0u;
+        Sampler sampler = Sampler::UNIFORM;
+        // NAPSAC only: radius (in pixels) of the target image neighborhood the rest
+        // of a subset is drawn from
+        float napsacRadius = 50.0f;
+        // Reject bad hypotheses early with a sequential probability ratio test
+        // while counting their inliers, at the cost of occasionally rejecting a
+        // good one
+        bool sprt = false;
+        // Refine every new best hypothesis by iterated least squares over its
+        // inliers with a shrinking threshold, and the final fit over all of its
+        // inliers (LO-RANSAC)
+        bool localOptimization = false;
+        // Number of consecutive hypotheses a single thread generates and verifies
+        // together, in the range [1, MAX_ITERS_PER_BATCH], which does not change
+        // the fit
+        uint32_t itersPerBatch = MAX_ITERS_PER_BATCH;
+    };
+
+    /**
+     * Summary of a single fit.
+     */
+    struct FitResult {
+        // The best fit, or an invalid Transformation object if the algorithm fails
+        core::Transformation transformation;
+        // Number of matching points consistent with the best fit, out of all of them
+        uint32_t numInliers = 0u;
+        uint32_t numMatches = 0u;
+        // Number of RANSAC iterations the fit took, out of the allowed budget
+        uint32_t numIters = 0u;
+        uint32_t maxIters = 0u;
+        // Number of matches checked for consistency, summed over all hypotheses
+        uint64_t numVerifications = 0u;
+    };
 private:
-    // Params that control the behavior of Transformation generation,
-    uint32_t maxIters = 50000u;
-    uint32_t minNonTrivialInliers = 2u;
-    float epsilon = 3.0f;
+    /**
+     * Minimal subset of matching points, stored in fixed-size arrays so that
+     * drawing a subset does not allocate any memory.
+     */
+    struct MinSubsetMatches {
+        core::homography::MinPointSet fromPts;
+        core::homography::MinPointSet toPts;
+        // Indicator that the subset passed the sanity checks
+        bool isSane = false;
+    };
+
+    /**
+     * Per-fit data precomputed from the matching points that drives the selection
+     * of minimal subsets.
+     */
+    struct SamplingContext {
+        uint32_t numMatches = 0u;
+        // PROSAC only: match indices sorted by descending quality
+        std::vector<uint32_t> sortedIndices;
+        // PROSAC only: iteration (1-based) up to which subsets are drawn from the
+        // best n matches, indexed by n - MIN_BUILD_POINTS
+        std::vector<uint32_t> growthSchedule;
+        // NAPSAC only: grid over the target points with cells of napsacRadius, stored
+        // as the cell of each match along with the matches bucketed by cell
+        cv::Size gridSize;
+        std::vector<uint32_t> cellOfMatch;
+        std::vector<uint32_t> cellStarts;
+        std::vector<uint32_t> cellMatchIndices;
+    };
+
+    /**
+     * Sequential probability ratio test (SPRT) that decides whether a hypothesis
+     * is bad while its matches are being verified.  Fixed for the duration of a
+     * round so that decisions do not depend on the order threads run in.
+     */
+    struct SprtTest {
+        // Probability that a match is consistent with a good (resp. bad) hypothesis
+        double inlierProb = 0.0;
+        double badConsistentProb = 0.0;
+        // Log likelihood ratio increments of consistent and inconsistent matches
+        double consistentLogRatio = 0.0;
+        double inconsistentLogRatio = 0.0;
+        // Hypotheses are rejected once their log likelihood ratio exceeds this
+        double logDecisionThreshold = 0.0;
+    };
+
+    /**
+     * Progress of verifying a hypothesis against the matches.
+     */
+    struct Verification {
+        // Number of consistent matches, only complete if the hypothesis was kept
+        uint32_t numInliers = 0u;
+        uint32_t numVerified = 0u;
+        double logLikelihoodRatio = 0.0;
+        bool isRejected = false;
+    };
+
+    /**
+     * Hypotheses of a batch that improved on all of its earlier ones along with
+     * the verification statistics of the batch, reduced over the batches of a round
+     * once they are all evaluated.
+     */
+    struct BatchResult {
+        // Improving hypotheses in increasing iteration order, none if every
+        // hypothesis of the batch was rejected
+        std::array<core::Transformation, MAX_ITERS_PER_BATCH> transformations;
+        std::array<uint32_t, MAX_ITERS_PER_BATCH> numInliers;
+        std::array<uint32_t, MAX_ITERS_PER_BATCH> iters;
+        uint32_t numImprovements = 0u;
+        // Consistency statistics of the rejected hypotheses
+        uint64_t numRejectedInliers = 0u;
+        uint64_t numRejectedVerified = 0u;
+        uint64_t numVerifications = 0u;
+    };
+
+    // Max number of subsets drawn per iteration in search of a sane one
+    static constexpr uint32_t maxSubsetAttempts = 8u;
+
+    // Bounds on the number of hypotheses generated between checks of the termination
+    // criterion, rounds start small and grow so easy fits can terminate quickly
+    static constexpr uint32_t minItersPerRound = 16u;
+    static constexpr uint32_t maxItersPerRound = 512u;
+
+    // Number of blocks of matches verified against all hypotheses of a batch at a
+    // time, sized so the coordinates of those matches stay in the L1 cache while
+    // being reused
+    static constexpr uint32_t blocksPerVerificationChunk = 64u;
+
+    // PROSAC only: probability that an incorrect model is consistent with a random
+    // match, and the one-sided normal quantile of the non-randomness test
+    static constexpr double prosacBeta = 0.05;
+    static constexpr double prosacNonRandomQuantile = 1.645;
+
+    // NAPSAC only: max number of grid cells along either side of the grid
+    static constexpr int32_t maxNapsacGridSide = 1024;
+
+    // SPRT only: cost of generating a hypothesis relative to verifying one match,
+    // and the initial guesses of the match consistency probabilities, which are
+    // then estimated as the fit progresses
+    static constexpr double sprtHypothesisCost = 200.0;
+    static constexpr double sprtInitialInlierProb = 0.1;
+    static constexpr double sprtInitialBadConsistentProb = 0.01;
+    static constexpr double sprtMinBadConsistentProb = 0.001;
+    static constexpr uint32_t sprtNumThresholdIters = 10u;
+
+    // LO-RANSAC only: number of least squares refits, the first of which uses
+    // inliers within this multiple of epsilon
+    static constexpr uint32_t numLocalOptimizationIters = 4u;
+    static constexpr float localOptimizationThreshMultiplier = 3.0f;
+
+    // Multiple instances only: each instance after the first is fit with the
+    // iteration budget of the previous one divided by this
+    static constexpr uint32_t instanceBudgetDivisor = 2u;
+
+    Params params;
 public:
+    /** 
+     * Builds a new TransformationFitter with the given params.
+     * 
+     * @param _params Params that control the behavior of the fit
+     */
+    TransformationFitter(const Params& _params);
+    TransformationFitter() {};
+
     /** 
      * Will attempt to fit a core::Transformation to the passed in matching points
      * in the presence of outliers.  If the algorithm succeeds, the best fit
@@ -32,26 +221,244 @@ public:
      *         fails
      */
     core::Transformation execute(const MatchingPoints& matches) const;
+
+    /** 
+     * Same as execute, but also reports statistics of the fit.
+     * 
+     * @param matches The set of matching points to perform the fit on, which
+     *                may contain outliers
+     * @return The best fit along with its number of inliers and the number
+     *         of RANSAC iterations actually run
+     */
+    FitResult fit(const MatchingPoints& matches) const;
+
+    /** 
+     * Fits several instances of the source object by sequential RANSAC: after each
+     * fit, its inliers are removed from the matching points and the rest are fit
+     * again, with a shrinking iteration budget, until a fit fails.
+     * 
+     * @param matches The set of matching points to perform the fits on, which
+     *                may contain outliers
+     * @param maxNumInstances Max number of instances to fit
+     * @return The fit of each instance found, in the order they were found,
+     *         where inliers are counted among the matches left for that instance
+     */
+    std::vector<FitResult> fitMultiple(const MatchingPoints& matches,
+            uint32_t maxNumInstances) const;
 private:
+    /** 
+     * Precomputes the data needed by the configured sampler.
+     * 
+     * @param matches The set of matching points subsets will be selected from
+     * @return The sampling context
+     */
+    SamplingContext buildSamplingContext(const MatchingPoints& matches) const;
+
+    /** 
+     * Buckets the target points of the matches into the NAPSAC grid.
+     * 
+     * @param matches The set of matching points subsets will be selected from
+     * @param samplingContext The sampling context to store the grid in
+     */
+    void buildNapsacGrid(const MatchingPoints& matches, SamplingContext& samplingContext) const;
+
     /** 
      * Selects a valid subset of matching points, the minimum number required to 
-     * build a valid core::Transformation object.
+     * build a valid core::Transformation object.  Subsets that fail the sanity
+     * checks are redrawn a few times.  The subset only depends on the seed and
+     * the iteration index.
      * 
      * @param matches The set of matching points select a subset from
-     * @return The aforementioned subset
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param iter Index of the RANSAC iteration the subset is drawn for
+     * @return The aforementioned subset, flagged if no sane subset was found
+     */
+    MinSubsetMatches getMinSubsetMatches(const MatchingPoints& matches,
+            const SamplingContext& samplingContext, uint32_t iter) const;
+
+    /** 
+     * Selects the indices of a PROSAC minimal subset: the n-th best match along
+     * with the rest drawn from the n - 1 better ones, where n grows with the
+     * iteration index.
+     * 
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param rng Random stream of the iteration
+     * @param iter Index of the RANSAC iteration the subset is drawn for
+     * @param indices Output array of MIN_BUILD_POINTS match indices
+     */
+    void sampleProsacIndices(const SamplingContext& samplingContext,
+            shared::RandomNumberGenerator& rng, uint32_t iter, uint32_t* indices) const;
+
+    /** 
+     * Selects the indices of a NAPSAC minimal subset: a random match along with
+     * the rest drawn from the matches in its neighborhood.  Falls back to a uniform
+     * subset if the neighborhood is too sparse.
+     * 
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param rng Random stream of the iteration
+     * @param indices Output array of MIN_BUILD_POINTS match indices
+     */
+    void sampleNapsacIndices(const SamplingContext& samplingContext,
+            shared::RandomNumberGenerator& rng, uint32_t* indices) const;
+
+    /** 
+     * Collects the matches in the grid cells neighboring the cell of a given match,
+     * excluding the match itself.  The neighborhood spans 3x3 cells.
+     * 
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param centerIndex Index of the match at the center of the neighborhood
+     * @param neighborFunction Called with the index of each neighboring match
+     */
+    template<typename NeighborFunction>
+    void forEachNapsacNeighbor(const SamplingContext& samplingContext, uint32_t centerIndex,
+            NeighborFunction neighborFunction) const;
+
+    /** 
+     * Generates and evaluates a batch of consecutive hypotheses.  Matches are
+     * verified a chunk at a time against every remaining hypothesis of the batch.
+     * 
+     * @param matches The set of matching points the fit is performed on
+     * @param matchCoordinates Coordinates of the same matching points
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param sprtTest SPRT of the current round
+     * @param maxRejectedInliers Hypotheses with at most this many inliers are
+     *                           rejected
+     * @param batchStart Index of the first RANSAC iteration of the batch
+     * @param batchEnd Index past the last RANSAC iteration of the batch
+     * @return The improving hypotheses of the batch along with its statistics
+     */
+    BatchResult evaluateBatch(const MatchingPoints& matches,
+            const core::homography::InlierCounter::MatchCoordinates& matchCoordinates,
+            const SamplingContext& samplingContext, const SprtTest& sprtTest,
+            uint32_t maxRejectedInliers, uint32_t batchStart, uint32_t batchEnd) const;
+
+    /** 
+     * Continues counting the matches consistent with a hypothesis up to a given
+     * block, stopping as soon as the hypothesis can be rejected: either it can
+     * no longer have more than a given number of inliers, or the SPRT deems it bad.
+     * 
+     * @param matchCoordinates Coordinates of the matching points to verify
+     * @param homography The hypothesis
+     * @param sprtTest SPRT of the current round
+     * @param maxRejectedInliers Hypotheses with at most this many inliers are
+     *                           rejected
+     * @param endBlock Index past the last block of matches to verify
+     * @param verification Progress of the verification, updated in place
+     */
+    void verifyHypothesis(
+            const core::homography::InlierCounter::MatchCoordinates& matchCoordinates,
+            const core::homography::Homography& homography, const SprtTest& sprtTest,
+            uint32_t maxRejectedInliers, uint32_t endBlock, Verification& verification) const;
+
+    /** 
+     * Builds the SPRT for the given match consistency probabilities.  The test
+     * never rejects anything if SPRT is disabled or the probabilities do not
+     * allow telling good and bad hypotheses apart.
+     * 
+     * @param inlierProb Probability that a match is consistent with a good hypothesis
+     * @param badConsistentProb Probability that a match is consistent with a bad
+     *                          hypothesis
+     * @return The test
+     */
+    SprtTest buildSprtTest(double inlierProb, double badConsistentProb) const;
+
+    /** 
+     * Refines a transformation by iterated least squares fits over its inliers,
+     * with a threshold that shrinks from a multiple of epsilon down to epsilon.
+     * 
+     * @param matches The set of matching points the fit is performed on
+     * @param matchCoordinates Coordinates of the same matching points
+     * @param transformation The transformation to refine, replaced if improved
+     * @param numInliers Number of inliers of the transformation, updated if improved
+     * @return Indicator that the transformation was improved
+     */
+    bool optimizeLocally(const MatchingPoints& matches,
+            const core::homography::InlierCounter::MatchCoordinates& matchCoordinates,
+            core::Transformation& transformation, uint32_t& numInliers) const;
+
+    /** 
+     * Builds the least squares fit over the inliers of a transformation.
+     * 
+     * @param matches The set of matching points the fit is performed on
+     * @param transformation A valid transformation
+     * @param epsilon Max distance of the inliers
+     * @return The fit, or an invalid Transformation object if there are too few
+     *         inliers
+     */
+    core::Transformation fitInliers(const MatchingPoints& matches,
+            const core::Transformation& transformation, float epsilon) const;
+
+    /** 
+     * Flags the matching points that are consistent with a transformation.
+     * 
+     * @param matches The set of matching points to flag
+     * @param transformation A valid transformation
+     * @param epsilon Max distance of consistent points
+     * @return Indicator of each match being an inlier
+     */
+    std::vector<bool> computeInlierMask(const MatchingPoints& matches,
+            const core::Transformation& transformation, float epsilon) const;
+
+    /** 
+     * Computes the number of RANSAC iterations required by the configured sampler
+     * to be confident in a new best fit, accounting for the SPRT wrongly rejecting
+     * good hypotheses.
+     * 
+     * @param matches The set of matching points the fit is performed on
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param sprtTest SPRT of the current round
+     * @param transformation The best fit found so far
+     * @param numInliers Number of inliers of the same fit
+     * @return The required number of iterations, capped by maxIters
+     */
+    uint32_t computeSamplerRequiredIters(const MatchingPoints& matches,
+            const SamplingContext& samplingContext, const SprtTest& sprtTest,
+            const core::Transformation& transformation, uint32_t numInliers) const;
+
+    /** 
+     * Computes the number of RANSAC iterations required to draw at least one
+     * outlier-free minimal subset with the configured confidence.
+     * 
+     * @param numInliers Number of inliers of the best fit found so far
+     * @param numMatches Total number of matching points
+     * @return The required number of iterations, capped by maxIters
+     */
+    uint32_t computeRequiredIters(uint32_t numInliers, uint32_t numMatches) const;
+
+    /** 
+     * Same as above, given the probability that a single minimal subset drawn
+     * by the sampler contains only inliers.
+     * 
+     * @param subsetSuccessProb The aforementioned probability
+     * @return The required number of iterations, capped by maxIters
+     */
+    uint32_t computeRequiredIters(double subsetSuccessProb) const;
+
+    /** 
+     * PROSAC counterpart of computeRequiredIters, which only requires enough
+     * iterations to be confident in the best non-random fit within the top
+     * quality matches.
+     * 
+     * @param matches The set of matching points the fit is performed on
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param transformation The best fit found so far
+     * @return The required number of iterations, capped by maxIters
      */
-    MatchingPoints getMinSubsetMatches(const MatchingPoints& matches) const;
+    uint32_t computeProsacRequiredIters(const MatchingPoints& matches,
+            const SamplingContext& samplingContext,
+            const core::Transformation& transformation) const;
 
     /** 
-     * Computes the number of point pairs that are similar (close enough).
+     * NAPSAC counterpart of computeRequiredIters, which accounts for subsets
+     * being drawn from the neighborhoods of the inliers of the best fit.
      * 
-     * @param points1 First list of points
-     * @param points2 Second list of points, paired respectively with the
-     *                first list of points
-     * @return The number of pairs that have similar points
+     * @param matches The set of matching points the fit is performed on
+     * @param samplingContext Precomputed sampling data of the matches
+     * @param transformation The best fit found so far
+     * @return The required number of iterations, capped by maxIters
      */
-    uint32_t computeNumSimilarPoints(
-                const std::vector<cv::Point>& points1,
-                const std::vector<cv::Point>& points2) const;
+    uint32_t computeNapsacRequiredIters(const MatchingPoints& matches,
+            const SamplingContext& samplingContext,
+            const core::Transformation& transformation) const;
 };
 
@@ -8,12 +8,15 @@
 
 #include "opencv2/core.hpp"
 
+#include "core/homography/Definitions.hpp"
+#include "core/homography/Evaluator.hpp"
+
 namespace core {
 
 class Transformation {
 private:
     bool isTransformationValid = false;
-    cv::Mat transformation;
+    homography::Homography transformation;
 public:
     /** 
      * Estimates a transformation between the matching points.
@@ -24,6 +27,27 @@ public:
     void build(const std::vector<cv::Point>& fromPts,
             const std::vector<cv::Point>& toPts);
 
+    /** 
+     * Same as above, for matching points stored in fixed-size arrays, which
+     * does not allocate any memory.
+     *
+     * @param fromPts Source points in the matching pairs
+     * @param toPts Target points in the matching pairs
+     */
+    void build(const homography::MinPointSet& fromPts,
+            const homography::MinPointSet& toPts);
+
+    /** 
+     * Estimates the transformation that best fits any number of matching points,
+     * in the least squares sense.  Meant to refine a transformation from its
+     * inliers, so the points are assumed to be in a sane configuration.
+     *
+     * @param fromPts Source points in the matching pairs, at least 4
+     * @param toPts Target points in the matching pairs
+     */
+    void buildLeastSquares(const std::vector<cv::Point>& fromPts,
+            const std::vector<cv::Point>& toPts);
+
     /** 
      * Checks if the object represents a valid transformation.
      *
@@ -31,6 +55,13 @@ public:
      */
     bool isValid() const;
 
+    /** 
+     * Gets the underlying homography, only meaningful if the object is valid.
+     *
+     * @return The homography matrix
+     */
+    const homography::Homography& getHomography() const;
+
     /** 
      * Transforms the inputPoints if possible.
      *
@@ -40,6 +71,37 @@ public:
      */
     std::vector<cv::Point> apply(const std::vector<cv::Point>& inputPts) const;
 
+    /** 
+     * Same as above, but writes the transformed points into an existing vector,
+     * which reuses its memory.
+     *
+     * @param inputPts The points to transform
+     * @param outputPts Output transformed points, or an empty vector if
+     *                  transformation is not possible
+     */
+    void apply(const std::vector<cv::Point>& inputPts,
+            std::vector<cv::Point>& outputPts) const;
+
+    /** 
+     * Projects the outer corners of an image, (0, 0), (width, 0), (width, height)
+     * and (0, height) in this order, with sub-pixel precision.
+     *
+     * @param imageSize Dimensions of the image to transform
+     * @return The projected corners
+     */
+    std::vector<cv::Point2f> projectCorners(const cv::Size& imageSize) const;
+
+    /** 
+     * Checks if transforming an image of the given size onto a target image of the
+     * given size is sane, i.e. the transformation is valid and the transformed image
+     * keeps its orientation and lands fully inside the target image.
+     *
+     * @param targetSize Dimensions of the image to be augmented onto
+     * @param replacementSize Dimensions of the image to transform
+     * @return Indicator that the augmentation is sane
+     */
+    bool isAugmentationSane(const cv::Size& targetSize, const cv::Size& replacementSize) const;
+
     /** 
      * Transforms the replacementImage onto the targetImage if possible.
      *
@@ -50,6 +112,88 @@ public:
      */
     cv::Mat augment(const cv::Mat& targetImage,
             const cv::Mat& replacementImage) const;
+
+    /** 
+     * Transforms the replacementImage onto the targetImage once per transformation,
+     * in a single pass over the targetImage.  Transformations that are not valid
+     * or do not produce a sane augmentation are skipped, and where instances
+     * overlap, the earliest one is shown.
+     *
+     * @param targetImage The image to be augmented onto
+     * @param replacementImage The image to transform onto the targetImage
+     * @param transformations The transformation of each instance
+     * @return The augmented image or a copy of the target image if no
+     *         augmentation is possible
+     */
+    static cv::Mat augment(const cv::Mat& targetImage, const cv::Mat& replacementImage,
+            const std::vector<Transformation>& transformations);
+
+    /** 
+     * Same as above, but samples the replacement image from the level of its pyramid
+     * suited to how much the transformations shrink it.
+     *
+     * @param targetImage The image to be augmented onto
+     * @param replacementPyramid Pyramid of the image to transform onto the targetImage,
+     *                           see buildReplacementPyramid
+     * @param transformations The transformation of each instance
+     * @return The augmented image or a copy of the target image if no
+     *         augmentation is possible
+     */
+    static cv::Mat augment(const cv::Mat& targetImage,
+            const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Transformation>& transformations);
+
+    /** 
+     * Same as above, but augments the image in place, only writing the pixels the
+     * replacement image lands on, and nothing at all if no augmentation is possible.
+     *
+     * @param image The image to be augmented onto, in place
+     * @param replacementPyramid Pyramid of the image to transform onto the image
+     * @param transformations The transformation of each instance
+     * @param warpCache Optional cache of the warp, reused while the transformations
+     *                  barely move, see homography::Evaluator::augmentInPlace
+     * @return Indicator that any instance was augmented onto the image
+     */
+    static bool augmentInPlace(cv::Mat& image, const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Transformation>& transformations,
+            homography::Evaluator::WarpCache* warpCache = nullptr);
+
+    /** 
+     * Same as above, but only warps the replacement image without touching any
+     * image, leaving the warp in the warp cache, see homography::Evaluator::warp.
+     *
+     * @param imageSize Dimensions of the image to be augmented onto
+     * @param replacementPyramid Pyramid of the image to transform onto the image
+     * @param transformations The transformation of each instance
+     * @param warpCache The warp cache, holding the warp on return
+     * @return Indicator that any instance was warped, the warp cache is left as is
+     *         otherwise
+     */
+    static bool warp(const cv::Size& imageSize, const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Transformation>& transformations,
+            homography::Evaluator::WarpCache& warpCache);
+
+    /** 
+     * Builds the pyramid of a replacement image, the levels of which are successively
+     * halved versions of it.  Meant to be built once per replacement image and reused
+     * across augmentations.
+     *
+     * @param replacementImage The image to build the pyramid of
+     * @return The levels of the pyramid, starting with the replacement image
+     */
+    static std::vector<cv::Mat> buildReplacementPyramid(const cv::Mat& replacementImage);
+private:
+    /** 
+     * Selects the homographies of the transformations whose augmentation is sane.
+     *
+     * @param imageSize Dimensions of the image to be augmented onto
+     * @param replacementSize Dimensions of the base level of the replacement image
+     * @param transformations The transformation of each instance
+     * @return The homography of each sane instance
+     */
+    static std::vector<homography::Homography> selectSaneHomographies(
+            const cv::Size& imageSize, const cv::Size& replacementSize,
+            const std::vector<Transformation>& transformations);
 };
 
 }
@@ -4,7 +4,6 @@
 
 #pragma once
 
-#include <string>
 #include <vector>
 
 #include "opencv2/core.hpp"
@@ -18,8 +17,9 @@ namespace homography {
 
 class Builder {
 private:
-    static constexpr uint32_t numRowsA = 2*MIN_BUILD_POINTS;
-    static constexpr uint32_t numColsA = numRowsA + 1u;
+    static constexpr uint32_t numUnknowns = 2*MIN_BUILD_POINTS;
+    // Pivots smaller than this (in normalized coordinates) indicate a singular system
+    static constexpr double minPivotMagnitude = 1e-10;
 public:
     /** 
      * Builds a homography that defines a transformation between the passed in
@@ -27,21 +27,81 @@ public:
      *
      * @param fromPts Source points in the matching pairs
      * @param toPts Target points in the matching pairs
-     * @return The homography matrix
+     * @param homography Output homography matrix, only written on success
+     * @return Indicator that the homography could be built
      */
-    static cv::Mat build(const std::vector<cv::Point>& fromPts,
-            const std::vector<cv::Point>& toPts);
-private:
+    static bool build(const MinPointSet& fromPts, const MinPointSet& toPts,
+            Homography& homography);
+
     /** 
-     * Builds the "A" matrix, which represents the system of 8 equations used to
-     * build a homography.
+     * Builds the homography that best fits any number of matching points, in
+     * the least squares sense.
      *
-     * @param fromPts Source points in the matching pairs
+     * @param fromPts Source points in the matching pairs, at least MIN_BUILD_POINTS
      * @param toPts Target points in the matching pairs
-     * @return The "A" matrix
+     * @param homography Output homography matrix, only written on success
+     * @return Indicator that the homography could be built
+     */
+    static bool buildLeastSquares(const std::vector<cv::Point>& fromPts,
+            const std::vector<cv::Point>& toPts, Homography& homography);
+private:
+    /** 
+     * Fills the two equations a single match contributes to the system that
+     * defines the homography between normalized points.
+     *
+     * @param fromPt Normalized source point
+     * @param toPt Normalized target point
+     * @param rowX Output coefficients of the equation of the x coordinate
+     * @param rowY Output coefficients of the equation of the y coordinate
+     * @param rhs Output right hand sides of both equations
+     */
+    static void fillEquations(const cv::Point2d& fromPt, const cv::Point2d& toPt,
+            double (&rowX)[numUnknowns], double (&rowY)[numUnknowns], cv::Point2d& rhs);
+
+    /** 
+     * Converts the solution of the system of equations to the homography between
+     * the original points.
+     *
+     * @param solution Solution of the system of equations
+     * @param fromNormalization Normalizing transform of the source points
+     * @param toNormalization Normalizing transform of the target points
+     * @return The homography matrix
+     */
+    static Homography denormalize(const double (&solution)[numUnknowns],
+            const cv::Matx33d& fromNormalization, const cv::Matx33d& toNormalization);
+
+    /** 
+     * Computes the similarity transform that moves the centroid of the points to
+     * the origin and scales their mean distance to it to sqrt(2), which keeps the
+     * system of equations well-conditioned.
+     *
+     * @param points Points to normalize
+     * @param numPoints Number of points
+     * @param normalization Output normalizing transform
+     * @return Indicator that the points can be normalized (are not all identical)
+     */
+    static bool computeNormalization(const cv::Point* points, uint32_t numPoints,
+            cv::Matx33d& normalization);
+
+    /** 
+     * Applies a normalizing transform to a point.
+     *
+     * @param normalization The normalizing transform
+     * @param point Point to normalize
+     * @return The normalized point
+     */
+    static cv::Point2d normalize(const cv::Matx33d& normalization, const cv::Point& point);
+
+    /** 
+     * Solves the square system of equations Ax = b in place using Gaussian
+     * elimination with partial pivoting.
+     *
+     * @param A System matrix, overwritten
+     * @param b Right hand side, overwritten with the solution
+     * @return Indicator that the system is not singular
      */
-    static cv::Mat buildA(const std::vector<cv::Point>& fromPts,
-            const std::vector<cv::Point>& toPts);
+    static bool solveInPlace(double (&A)[numUnknowns][numUnknowns],
+            double (&b)[numUnknowns]);
 };
 
 }
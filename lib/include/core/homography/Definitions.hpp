@@ -4,12 +4,22 @@
 
 #pragma once
 
+#include <array>
+#include <cstdint>
+
+#include "opencv2/core.hpp"
+
 namespace core {
 namespace homography {
 
 static constexpr uint32_t MIN_BUILD_POINTS = 4u;
 static constexpr uint32_t TRANSFORM_MAT_SIDE = 3u;
 
+// Fixed-size types that live on the stack, which keeps building and applying
+// homographies free of heap allocations
+using Homography = cv::Matx33f;
+using MinPointSet = std::array<cv::Point, MIN_BUILD_POINTS>;
+
 }
 }
 
@@ -4,15 +4,76 @@
 
 #pragma once
 
+#include <cmath>
 #include <vector>
 
 #include "opencv2/core.hpp"
 
+#include "core/homography/Definitions.hpp"
+
 namespace core {
 namespace homography {
 
 class Evaluator {
+public:
+    /**
+     * Contains the warp of the last augmentation that went through it, so that
+     * augmenting with nearly the same homographies, as a fixed camera does from frame
+     * to frame, reuses it instead of warping again.
+     */
+    struct WarpCache {
+        // Max distance in pixels any projected corner of the replacement image may
+        // move by for the cached warp to be reused as is
+        float maxCornerDisplacement;
+
+        // Key of the cached warp: the type and dimensions of the image to augment and
+        // the projected corners of the replacement image for each instance
+        int32_t imageType = -1;
+        cv::Size imageSize;
+        std::vector<cv::Point2f> replacementCorners;
+
+        // Level of the replacement pyramid sampled, region of the image augmented and
+        // the position of each of its pixels in that level
+        uint32_t level = 0u;
+        cv::Rect region;
+        cv::Mat mapXs;
+        cv::Mat mapYs;
+
+        // Level the warped pixels were sampled from, the warped pixels of the region
+        // and the mask of those composited onto the image, single channel for uint8
+        // images and per channel for float32 ones.  Pixels outside of the mask are 0
+        // for uint8 images and unspecified otherwise
+        cv::Mat sampledImage;
+        cv::Mat warpedRegion;
+        cv::Mat coverageMask;
+
+        explicit WarpCache(float _maxCornerDisplacement = 0.0f) :
+                maxCornerDisplacement(_maxCornerDisplacement) {};
+    };
+private:
+    // Replacement image pyramids stop before either side of a level drops below this
+    static constexpr int32_t minPyramidLevelSide = 8;
 public:
+    /** 
+     * Applies a homography to a single point.
+     *
+     * @note OPTIMIZATION: Making this function inline empirically improves performance
+     *
+     * @param inputPt Point to transform using a homography
+     * @param homography The homography transform matrix
+     * @return The transformed point
+     */
+    static inline cv::Point applyPoint(const cv::Point& inputPt, const Homography& homography) {
+        const float x = (float)inputPt.x;
+        const float y = (float)inputPt.y;
+        const float coordScale = 1.0f/
+                (homography(2, 0)*x + homography(2, 1)*y + homography(2, 2));
+        return {(int32_t)std::round(coordScale*
+                        (homography(0, 0)*x + homography(0, 1)*y + homography(0, 2))),
+                (int32_t)std::round(coordScale*
+                        (homography(1, 0)*x + homography(1, 1)*y + homography(1, 2)))};
+    };
+
     /** 
      * Applies a homography to a list of points.
      *
@@ -21,7 +82,29 @@ public:
      * @return The transformed points
      */
     static std::vector<cv::Point> applyPoints(
-            const std::vector<cv::Point>& inputPts, const cv::Mat& homography);
+            const std::vector<cv::Point>& inputPts, const Homography& homography);
+
+    /** 
+     * Same as above, but writes the transformed points into an existing vector,
+     * which reuses its memory.
+     *
+     * @param inputPts Points to transform using a homography 
+     * @param homography The homography transform matrix
+     * @param outputPts Output transformed points
+     */
+    static void applyPoints(const std::vector<cv::Point>& inputPts,
+            const Homography& homography, std::vector<cv::Point>& outputPts);
+
+    /** 
+     * Projects the outer corners of an image, (0, 0), (width, 0), (width, height)
+     * and (0, height) in this order, through each homography.
+     *
+     * @param imageSize Dimensions of the image
+     * @param homographies The homography transform matrix of each instance
+     * @return The projected corners, MIN_BUILD_POINTS per instance
+     */
+    static std::vector<cv::Point2f> projectCorners(const cv::Size& imageSize,
+            const std::vector<Homography>& homographies);
 
     /** 
      * Does a fast sanity check to see if augmentation makes sense.
@@ -31,11 +114,14 @@ public:
      * @param homography The homography transform matrix
      * @return Indicator that the sanity check passed
      */
-    static bool isAugmentationSane(const std::vector<cv::Point>& replacementPoints,
-            const cv::Rect& targetRegion, const cv::Mat& homography);
+    static bool isAugmentationSane(const MinPointSet& replacementPoints,
+            const cv::Rect& targetRegion, const Homography& homography);
 
     /** 
      * Applies a homography to a (replacement) image to augment another (target) image.
+     * Both images must be of the same type, uint8 images are composited in fixed point
+     * and match the composition of the same images in float32 within one unit of
+     * the least significant bit.
      *
      * @param targetImage Image to augment
      * @param replacementImage Image to transform onto the target image
@@ -43,26 +129,174 @@ public:
      * @return The augmented image
      */
     static cv::Mat augment(const cv::Mat& targetImage,
-            const cv::Mat& replacementImage, const cv::Mat& homography);
+            const cv::Mat& replacementImage, const Homography& homography);
+
+    /** 
+     * Same as above, for several instances of the replacement image transformed by
+     * different homographies, composited in a single pass over the target image.
+     * Where instances overlap, the earliest one is shown.
+     *
+     * @param targetImage Image to augment
+     * @param replacementImage Image to transform onto the target image
+     * @param homographies The homography transform matrix of each instance
+     * @return The augmented image
+     */
+    static cv::Mat augment(const cv::Mat& targetImage, const cv::Mat& replacementImage,
+            const std::vector<Homography>& homographies);
+
+    /** 
+     * Same as above, but augments the image in place, only writing the pixels
+     * the replacement image lands on.
+     *
+     * @param image Image to augment in place
+     * @param replacementImage Image to transform onto the image
+     * @param homographies The homography transform matrix of each instance
+     */
+    static void augmentInPlace(cv::Mat& image, const cv::Mat& replacementImage,
+            const std::vector<Homography>& homographies);
+
+    /** 
+     * Same as above, but samples the replacement image from the level of its pyramid
+     * suited to how much the instances shrink it, which is faster and avoids
+     * aliasing.  The level is chosen for the least shrunk instance.
+     *
+     * @param targetImage Image to augment
+     * @param replacementPyramid Pyramid of the image to transform onto the target
+     *                           image, see buildPyramid
+     * @param homographies The homography transform matrix of each instance, from
+     *                     the base level of the pyramid
+     * @return The augmented image
+     */
+    static cv::Mat augment(const cv::Mat& targetImage,
+            const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Homography>& homographies);
+
+    /** 
+     * Same as above, but augments the image in place, only writing the pixels
+     * the replacement image lands on.  With a warp cache, the positions of the
+     * pixels in the replacement image are kept and reused while no projected corner
+     * of the replacement image moves by more than the tolerance of the cache, and so
+     * are the warped pixels while the replacement pyramid stays the same.
+     *
+     * @param image Image to augment in place
+     * @param replacementPyramid Pyramid of the image to transform onto the image
+     * @param homographies The homography transform matrix of each instance, from
+     *                     the base level of the pyramid
+     * @param warpCache Optional cache of the warp, updated when it can't be reused
+     */
+    static void augmentInPlace(cv::Mat& image, const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Homography>& homographies, WarpCache* warpCache = nullptr);
+
+    /** 
+     * Warps a replacement image for augmenting an image of the given dimensions,
+     * without touching the image.  The warp is left in the warp cache: the region of
+     * the image it covers, the warped pixels of the region and the mask of those
+     * augmentation writes, see augmentInPlace for when the cached warp is reused.
+     *
+     * @param imageSize Dimensions of the image to augment
+     * @param replacementPyramid Pyramid of the image to transform onto the image
+     * @param homographies The homography transform matrix of each instance, from
+     *                     the base level of the pyramid
+     * @param warpCache The warp cache, updated when it can't be reused
+     */
+    static void warp(const cv::Size& imageSize, const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Homography>& homographies, WarpCache& warpCache);
+
+    /** 
+     * Builds the pyramid of a replacement image, where each level halves the
+     * dimensions of the previous one and pixel (x, y) of level l lies at
+     * (x*2^l, y*2^l) in the base level.
+     *
+     * @param replacementImage Image to build the pyramid of, the base level
+     * @return The levels of the pyramid, starting with the replacement image
+     */
+    static std::vector<cv::Mat> buildPyramid(const cv::Mat& replacementImage);
 private:
     /** 
-     * Utility routine that converts the representation of a list of points
-     * from a vector of cv::Points to matrix form to facilitate easier
-     * transformation.
+     * Chooses the level of a replacement image pyramid to sample an instance from,
+     * the coarsest one that is still at least as detailed as the instance.
      *
-     * @param points Vector representation of points to convert
-     * @return Matrix representation of the points
+     * @param replacementSize Dimensions of the base level of the pyramid
+     * @param numLevels Number of levels of the pyramid
+     * @param homography The homography transform matrix of the instance
+     * @return Index of the level
      */
-    static cv::Mat convertPointsToMat(const std::vector<cv::Point>& points);
+    static uint32_t choosePyramidLevel(const cv::Size& replacementSize, uint32_t numLevels,
+            const Homography& homography);
 
     /** 
-     * Utility routine that converts the representation of a list of points
-     * from matrix form to a vector of cv::Points.
+     * Chooses the level of a replacement image pyramid to sample all instances
+     * from, the finest one chosen for any instance, see choosePyramidLevel.
      *
-     * @param pointsMat Matrix representation of points to convert
-     * @return Vector representation of points
+     * @param replacementPyramid Pyramid of the image to transform
+     * @param homographies The homography transform matrix of each instance, from
+     *                     the base level of the pyramid
+     * @param levelHomographies Output homography transform matrix of each instance,
+     *                          from the chosen level
+     * @return Index of the level
      */
-    static std::vector<cv::Point> convertMatToPoints(const cv::Mat& pointsMat);
+    static uint32_t choosePyramidLevel(const std::vector<cv::Mat>& replacementPyramid,
+            const std::vector<Homography>& homographies,
+            std::vector<Homography>& levelHomographies);
+
+    /** 
+     * Checks whether the positions cached by a warp cache can be reused to augment
+     * an image.
+     *
+     * @param warpCache The warp cache
+     * @param imageSize Dimensions of the image to augment
+     * @param imageType Type of the image to augment
+     * @param replacementCorners Projected corners of the replacement image, see
+     *                           projectCorners
+     * @return Indicator that the cached positions can be reused
+     */
+    static bool isWarpReusable(const WarpCache& warpCache, const cv::Size& imageSize,
+            int32_t imageType, const std::vector<cv::Point2f>& replacementCorners);
+
+    /** 
+     * Computes the inverse homographies mapping a region of the target image onto
+     * the replacement image.
+     *
+     * @param region Region of the target image
+     * @param homographies The homography transform matrix of each instance
+     * @return The inverse homography of each instance
+     */
+    static std::vector<Homography> invertOntoRegion(const cv::Rect& region,
+            const std::vector<Homography>& homographies);
+
+    /** 
+     * Computes the region of the target image that augmentation by the given
+     * homographies can change, the bounding box of the projected replacement images.
+     *
+     * @param targetSize Dimensions of the image to augment
+     * @param replacementSize Dimensions of the image to transform
+     * @param homographies The homography transform matrix of each instance
+     * @return The aforementioned region, clipped to the target image
+     */
+    static cv::Rect computeAugmentedRegion(const cv::Size& targetSize,
+            const cv::Size& replacementSize, const std::vector<Homography>& homographies);
+
+    /** 
+     * Composites the replacement image onto a region of a float32 target image.
+     *
+     * @param replacementImage Image to transform onto the region
+     * @param inverseHomographies Inverse homography of each instance, mapping the
+     *                            region onto the replacement image
+     * @param regionImage The region of the target image, augmented in place
+     */
+    static void augmentRegionFloat(const cv::Mat& replacementImage,
+            const std::vector<Homography>& inverseHomographies, cv::Mat& regionImage);
+
+    /** 
+     * Same as above, for uint8 images, see Warper::warpUint8.
+     *
+     * @param replacementImage Image to transform onto the region
+     * @param inverseHomographies Inverse homography of each instance, mapping the
+     *                            region onto the replacement image
+     * @param regionImage The region of the target image, augmented in place
+     */
+    static void augmentRegionUint8(const cv::Mat& replacementImage,
+            const std::vector<Homography>& inverseHomographies, cv::Mat& regionImage);
 
     /** 
      * Utility routine that checks if a list of points are inside a given
@@ -72,10 +306,8 @@ private:
      * @param rect The ROI of interest
      * @return Indicator that every point lies within the ROI
      */
-    static bool arePointsInside(const std::vector<cv::Point>& points,
-            const cv::Rect& rect);
+    static bool arePointsInside(const MinPointSet& points, const cv::Rect& rect);
 };
 
 }
 }
-
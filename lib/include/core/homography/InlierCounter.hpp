@@ -0,0 +1,136 @@
+/**
+ * This class counts the matching points that are consistent with a homography.
+ * Coordinates are stored as a structure of arrays so that blocks of points can be
+ * projected and checked together, using AVX2 when it is available.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "opencv2/core.hpp"
+
+#include "core/homography/Definitions.hpp"
+
+namespace core {
+namespace homography {
+
+class InlierCounter {
+public:
+    // Number of matching points checked together, the number of floats in an
+    // AVX2 register
+    static constexpr uint32_t BLOCK_SIZE = 8u;
+
+    /**
+     * Float coordinates of matching points, each array padded to a whole number
+     * of blocks with points that are never consistent.
+     */
+    struct MatchCoordinates {
+        uint32_t numPoints = 0u;
+        std::vector<float> fromXs;
+        std::vector<float> fromYs;
+        std::vector<float> toXs;
+        std::vector<float> toYs;
+    };
+
+    /** 
+     * Converts matching points to the structure of arrays layout.
+     *
+     * @param fromPts Source points in the matching pairs
+     * @param toPts Target points in the matching pairs
+     * @return The converted coordinates
+     */
+    static MatchCoordinates buildMatchCoordinates(const std::vector<cv::Point>& fromPts,
+            const std::vector<cv::Point>& toPts);
+
+    /** 
+     * Gets the number of blocks the matching points are split into.
+     *
+     * @param matchCoordinates Coordinates of the matching points
+     * @return The number of blocks
+     */
+    static inline uint32_t getNumBlocks(const MatchCoordinates& matchCoordinates) {
+        return matchCoordinates.fromXs.size()/BLOCK_SIZE;
+    };
+
+    /** 
+     * Checks which matching points of a block are consistent with a homography,
+     * i.e. have their source point mapped within epsilon of their target point.
+     *
+     * @note OPTIMIZATION: Making this function inline empirically improves performance
+     *
+     * @param matchCoordinates Coordinates of the matching points
+     * @param iBlock Index of the block to check
+     * @param homography The homography transform matrix
+     * @param sqrEpsilon Squared max distance of consistent points
+     * @return Bitmask of the consistent points, bit i for point i of the block
+     */
+    static inline uint32_t checkBlock(const MatchCoordinates& matchCoordinates,
+            uint32_t iBlock, const Homography& homography, float sqrEpsilon) {
+        const uint32_t blockStart = iBlock*BLOCK_SIZE;
+#ifdef __AVX2__
+        const __m256 x = _mm256_loadu_ps(&matchCoordinates.fromXs[blockStart]);
+        const __m256 y = _mm256_loadu_ps(&matchCoordinates.fromYs[blockStart]);
+        const __m256 w = _mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(homography(2, 0)), x),
+                _mm256_mul_ps(_mm256_set1_ps(homography(2, 1)), y)),
+                _mm256_set1_ps(homography(2, 2)));
+        const __m256 mappedX = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(homography(0, 0)), x),
+                _mm256_mul_ps(_mm256_set1_ps(homography(0, 1)), y)),
+                _mm256_set1_ps(homography(0, 2))), w);
+        const __m256 mappedY = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(
+                _mm256_mul_ps(_mm256_set1_ps(homography(1, 0)), x),
+                _mm256_mul_ps(_mm256_set1_ps(homography(1, 1)), y)),
+                _mm256_set1_ps(homography(1, 2))), w);
+        const __m256 dx = _mm256_sub_ps(mappedX,
+                _mm256_loadu_ps(&matchCoordinates.toXs[blockStart]));
+        const __m256 dy = _mm256_sub_ps(mappedY,
+                _mm256_loadu_ps(&matchCoordinates.toYs[blockStart]));
+        const __m256 sqrDistance = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+
+        // Ordered comparison, so the NaN padding is never consistent
+        return (uint32_t)_mm256_movemask_ps(
+                _mm256_cmp_ps(sqrDistance, _mm256_set1_ps(sqrEpsilon), _CMP_LT_OQ));
+#else
+        // Same operations in the same order as above, so both paths agree exactly
+        uint32_t blockMask = 0u;
+        for (uint32_t iPt = 0; iPt < BLOCK_SIZE; iPt++) {
+            const float x = matchCoordinates.fromXs[blockStart + iPt];
+            const float y = matchCoordinates.fromYs[blockStart + iPt];
+            const float w = (homography(2, 0)*x + homography(2, 1)*y) + homography(2, 2);
+            const float mappedX = ((homography(0, 0)*x + homography(0, 1)*y) + homography(0, 2))/w;
+            const float mappedY = ((homography(1, 0)*x + homography(1, 1)*y) + homography(1, 2))/w;
+            const float dx = mappedX - matchCoordinates.toXs[blockStart + iPt];
+            const float dy = mappedY - matchCoordinates.toYs[blockStart + iPt];
+            if (dx*dx + dy*dy < sqrEpsilon) {
+                blockMask |= (1u << iPt);
+            }
+        }
+
+        return blockMask;
+#endif
+    };
+
+    /** 
+     * Counts the matching points consistent with a homography.
+     *
+     * @param matchCoordinates Coordinates of the matching points
+     * @param homography The homography transform matrix
+     * @param epsilon Max distance of consistent points
+     * @param inlierMask Optional output bitmask of the consistent points, one
+     *                   byte per block as returned by checkBlock
+     * @return The number of consistent points
+     */
+    static uint32_t countInliers(const MatchCoordinates& matchCoordinates,
+            const Homography& homography, float epsilon,
+            std::vector<uint8_t>* inlierMask = nullptr);
+};
+
+}
+}
@@ -5,10 +5,12 @@
 
 #pragma once
 
-#include <vector>
+#include <cstdint>
 
 #include "opencv2/core.hpp"
 
+#include "core/homography/Definitions.hpp"
+
 namespace core {
 namespace homography {
 
@@ -18,48 +20,29 @@ public:
      * Check the matching points to determine if proceeding with building
      * a homography is sensible.
      *
-     * @param fromPts sOurce points in the matching pairs
+     * @param fromPts Source points in the matching pairs
      * @param toPts Target points in the matching pairs
      * @return Indicator that these matches can be used to build a homography
      */
-    static bool areMatchesSane(const std::vector<cv::Point>& fromPts,
-            const std::vector<cv::Point>& toPts);
+    static bool areMatchesSane(const MinPointSet& fromPts, const MinPointSet& toPts);
 private:
     /** 
-     * Checks if the list of points are in a degenerate configuration.
-     *
-     * @param points List of points to validate 
-     * @return Indicator that these points are in a degenerate configuration
-     */
-    static bool isConfigDegenerate(const std::vector<cv::Point>& points);
-
-    /** 
-     * Checks if the list of points are collinear (lie on the same line).
-     *
-     * @param points List of points to check for collinearity
-     * @return Indicator that these points are collinear
-     */
-    static bool arePointsCollinear(const std::vector<cv::Point>& points);
-
-    /** 
-     * Computes a descriptor that describes the orientation of the shape
-     * described by the points.
+     * Computes twice the signed area of the triangle formed by three points,
+     * positive if the points are in counter-clockwise order and zero if they are
+     * collinear.  Uses 64-bit arithmetic, which cannot overflow for any 32-bit
+     * coordinates.
      *
-     * @param points Shape to describe
-     * @return The shape descriptor
+     * @param point0 First point of the triangle
+     * @param point1 Second point of the triangle
+     * @param point2 Third point of the triangle
+     * @return Twice the signed area
      */
-    static std::vector<uint32_t> getOrientationDescriptor(
-            const std::vector<cv::Point>& points);
-
-    /** 
-     * Computes a list of indices that correspond to the input list in sorted order.
-     *
-     * @param points List of values to get sorted indices for
-     * @return The sorted indices
-     */
-    static std::vector<uint32_t> sortIndices(const std::vector<float>& input);
+    static inline int64_t computeSignedArea(const cv::Point& point0, const cv::Point& point1,
+            const cv::Point& point2) {
+        return ((int64_t)point1.x - point0.x)*((int64_t)point2.y - point0.y) -
+                ((int64_t)point1.y - point0.y)*((int64_t)point2.x - point0.x);
+    };
 };
 
 }
 }
-
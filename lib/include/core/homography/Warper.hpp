@@ -0,0 +1,131 @@
+/**
+ * This class warps a (replacement) image onto a region of another image through
+ * inverse homographies.  Rows are processed in blocks of pixels and in bands of rows
+ * in parallel, using AVX2 when it is available.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "core/homography/Definitions.hpp"
+
+namespace core {
+namespace homography {
+
+class Warper {
+public:
+    // Number of pixels mapped and sampled together, the number of floats in an
+    // AVX2 register
+    static constexpr int32_t BLOCK_SIZE = 8;
+private:
+    // Sample positions are quantized to this many bits per pixel along each axis,
+    // same as cv::remap
+    static constexpr int32_t interpTableBits = 5;
+    static constexpr int32_t interpTableSize = 1 << interpTableBits;
+
+    // Number of consecutive rows processed by a single thread
+    static constexpr int32_t rowsPerBand = 8;
+
+    // Coordinate of the pixels no homography covers, far enough out of the replacement
+    // image that they only sample the boundary value
+    static constexpr float unmappedCoord = -2.0f;
+public:
+    /** 
+     * Maps every pixel of a region back onto the replacement image through the first
+     * inverse homography that lands within interpolation reach of it, as needed by
+     * cv::remap.  Pixels no homography covers only sample the boundary value.
+     *
+     * @param inverseHomographies Inverse homography of each instance, mapping the
+     *                            region onto the replacement image
+     * @param replacementSize Dimensions of the replacement image
+     * @param mapXs Output column of each pixel in the replacement image, a float32
+     *              image of the region dimensions
+     * @param mapYs Output row of each pixel in the replacement image, same as above
+     */
+    static void mapRegion(const std::vector<Homography>& inverseHomographies,
+            const cv::Size& replacementSize, cv::Mat& mapXs, cv::Mat& mapYs);
+
+    /** 
+     * Composites the replacement image onto a region of a uint8 image in place, by
+     * bilinear interpolation in fixed point at the positions given by mapRegion.
+     * Pixels whose interpolation only reaches outside of the replacement image keep
+     * their value, the others blend with the negated max pixel value there, so the
+     * result matches compositing the same images in float32 with cv::remap within
+     * one unit of the least significant bit.
+     *
+     * @param replacementImage Image to transform onto the region, of the same type
+     *                         as the region
+     * @param inverseHomographies Inverse homography of each instance, mapping the
+     *                            region onto the replacement image
+     * @param regionImage The region of the target image, augmented in place
+     */
+    static void warpUint8(const cv::Mat& replacementImage,
+            const std::vector<Homography>& inverseHomographies, cv::Mat& regionImage);
+
+    /** 
+     * Same as above, but at positions precomputed by mapRegion, and optionally marks
+     * the pixels that were written, the others keeping their value.
+     *
+     * @param replacementImage Image to transform onto the region, of the same type
+     *                         as the region
+     * @param mapXs Column of each pixel in the replacement image, see mapRegion
+     * @param mapYs Row of each pixel in the replacement image, same as above
+     * @param regionImage The region of the target image, augmented in place
+     * @param coverageMask Optional output uint8 mask of the region dimensions, 255
+     *                     where a pixel was written and 0 elsewhere
+     */
+    static void sampleRegionUint8(const cv::Mat& replacementImage, const cv::Mat& mapXs,
+            const cv::Mat& mapYs, cv::Mat& regionImage, cv::Mat* coverageMask = nullptr);
+private:
+    /** 
+     * Maps a row of a region back onto the replacement image, see mapRegion.  The
+     * row terms of the projections are computed once, and each block of pixels
+     * steps the homogeneous coordinates from its first pixel.
+     *
+     * @param y Row of the region
+     * @param width Number of pixels of the row
+     * @param inverseHomographies Inverse homography of each instance, mapping the
+     *                            region onto the replacement image
+     * @param replacementSize Dimensions of the replacement image
+     * @param mappedXs Output column of each pixel in the replacement image
+     * @param mappedYs Output row of each pixel in the replacement image
+     */
+    static void mapRow(int32_t y, int32_t width,
+            const std::vector<Homography>& inverseHomographies,
+            const cv::Size& replacementSize, float* mappedXs, float* mappedYs);
+
+    /** 
+     * Composites the replacement image onto a row of a uint8 image in place, see
+     * warpUint8.
+     *
+     * @param replacementImage Image to transform onto the row
+     * @param mappedXs Column of each pixel in the replacement image
+     * @param mappedYs Row of each pixel in the replacement image
+     * @param width Number of pixels of the row
+     * @param row The row, augmented in place
+     * @param coverageRow Optional output mask of the row, set to 255 where a pixel
+     *                    was written and left as is elsewhere
+     */
+    static void sampleRow(const cv::Mat& replacementImage, const float* mappedXs,
+            const float* mappedYs, int32_t width, uint8_t* row, uint8_t* coverageRow);
+
+    /** 
+     * Composites the replacement image onto a single uint8 pixel in place, see
+     * warpUint8.
+     *
+     * @param replacementImage Image to transform onto the pixel
+     * @param mappedX Column of the pixel in the replacement image
+     * @param mappedY Row of the pixel in the replacement image
+     * @param pixel The pixel, augmented in place
+     * @return Indicator that the pixel was written
+     */
+    static bool samplePixel(const cv::Mat& replacementImage, float mappedX, float mappedY,
+            uint8_t* pixel);
+};
+
+}
+}
@@ -0,0 +1,226 @@
+/**
+ * Bounded lock-free queue connecting a single producer thread to a single consumer
+ * thread (example: two consecutive stages of a pipeline).  Elements are stored in
+ * a fixed ring of slots allocated once, so the queue never allocates memory while
+ * in use, and a full queue holds its producer back.  Waiting on the queue spins
+ * briefly, then blocks so that an idle side doesn't take up a core.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "shared/Definitions.hpp"
+
+namespace shared {
+
+template <typename T>
+class BoundedQueue {
+private:
+    // Typical size of a cache line
+    static constexpr size_t cacheLineSize = 64u;
+
+    // Number of attempts made by push and pop before blocking, enough to ride out
+    // the other side being briefly busy
+    static constexpr uint32_t maxNumSpins = 64u;
+
+    /**
+     * Counter padded to a whole cache line, so that the producer and the consumer
+     * don't invalidate each other's counter on every operation.
+     */
+    struct PaddedCounter {
+        std::atomic<uint64_t> value;
+        char padding[cacheLineSize - sizeof(std::atomic<uint64_t>)];
+    };
+
+    std::vector<T> slots;
+    // Number of elements ever pushed and popped, the slot of an element is its
+    // position modulo the capacity
+    PaddedCounter numPushed;
+    PaddedCounter numPopped;
+
+    // Threads blocked in push or pop, only touched once the lock-free attempts
+    // failed or to wake such threads
+    std::atomic<uint32_t> numBlocked;
+    std::mutex blockMutex;
+    std::condition_variable blockCondition;
+public:
+    /**
+     * Builds a new empty queue.
+     *
+     * @param capacity Max number of elements held at once, must be at least 1
+     */
+    explicit BoundedQueue(uint32_t capacity) {
+        VALIDATE_ARGUMENT(capacity >= 1u, "BoundedQueue: Capacity must be at least 1");
+        slots.resize(capacity);
+        numPushed.value.store(0u);
+        numPopped.value.store(0u);
+        numBlocked.store(0u);
+    };
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /**
+     * Pushes an element at the back of the queue if it is not full.  Must only be
+     * called from the producer thread.
+     *
+     * @param value Element to push, moved from if it is pushed
+     * @return Indicator that the element was pushed
+     */
+    bool tryPush(T& value) {
+        if (!tryPushQuietly(value)) {
+            return false;
+        }
+
+        wakeBlocked();
+        return true;
+    };
+
+    /**
+     * Pops the element at the front of the queue if it is not empty.  Must only be
+     * called from the consumer thread.
+     *
+     * @param value Output popped element, left as is if the queue is empty
+     * @return Indicator that an element was popped
+     */
+    bool tryPop(T& value) {
+        if (!tryPopQuietly(value)) {
+            return false;
+        }
+
+        wakeBlocked();
+        return true;
+    };
+
+    /**
+     * Same as tryPush, but waits for room in the queue until the element is pushed
+     * or the given flag is raised.
+     *
+     * @param value Element to push, moved from if it is pushed
+     * @param isCancelled Flag raised (example: by another thread) to stop waiting,
+     *                    followed by a call to wakeAll
+     * @return Indicator that the element was pushed
+     */
+    bool push(T& value, const std::atomic<bool>& isCancelled) {
+        return wait([&]() { return tryPushQuietly(value); }, isCancelled);
+    };
+
+    /**
+     * Same as tryPop, but waits for an element until one is popped or the given
+     * flag is raised.
+     *
+     * @param value Output popped element, left as is if none was popped
+     * @param isCancelled Flag raised (example: by another thread) to stop waiting,
+     *                    followed by a call to wakeAll
+     * @return Indicator that an element was popped
+     */
+    bool pop(T& value, const std::atomic<bool>& isCancelled) {
+        return wait([&]() { return tryPopQuietly(value); }, isCancelled);
+    };
+
+    /**
+     * Wakes the threads blocked in push or pop so they check their flag again, to
+     * be called after raising it.  May be called from any thread.
+     */
+    void wakeAll() {
+        std::lock_guard<std::mutex> blockLock(blockMutex);
+        blockCondition.notify_all();
+    };
+private:
+    /**
+     * Same as tryPush, but without waking the consumer thread if it is blocked.
+     *
+     * @param value Element to push, moved from if it is pushed
+     * @return Indicator that the element was pushed
+     */
+    bool tryPushQuietly(T& value) {
+        const uint64_t iPush = numPushed.value.load(std::memory_order_relaxed);
+        if (iPush - numPopped.value.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+
+        slots[iPush % slots.size()] = std::move(value);
+        numPushed.value.store(iPush + 1u, std::memory_order_release);
+        return true;
+    };
+
+    /**
+     * Same as tryPop, but without waking the producer thread if it is blocked.
+     *
+     * @param value Output popped element, left as is if the queue is empty
+     * @return Indicator that an element was popped
+     */
+    bool tryPopQuietly(T& value) {
+        const uint64_t iPop = numPopped.value.load(std::memory_order_relaxed);
+        if (iPop == numPushed.value.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = std::move(slots[iPop % slots.size()]);
+        numPopped.value.store(iPop + 1u, std::memory_order_release);
+        return true;
+    };
+
+    /**
+     * Retries an attempt to push or pop a bounded number of times, then blocks
+     * until it succeeds or the given flag is raised, and wakes the other side on
+     * success.
+     *
+     * @param attempt Function attempting to push or pop without waking the other side
+     * @param isCancelled Flag raised to stop waiting
+     * @return Indicator that the attempt succeeded
+     */
+    template<typename AttemptFunction>
+    bool wait(AttemptFunction attempt, const std::atomic<bool>& isCancelled) {
+        bool isDone = false;
+        for (uint32_t iSpin = 0; iSpin < maxNumSpins && !isDone; iSpin++) {
+            isDone = attempt();
+            if (!isDone) {
+                if (isCancelled.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        if (!isDone) {
+            // Either the other side sees this thread blocked once it made progress, or
+            // this thread sees that progress before blocking (see wakeBlocked)
+            std::unique_lock<std::mutex> blockLock(blockMutex);
+            numBlocked.fetch_add(1u);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            blockCondition.wait(blockLock, [&]() {
+                isDone = attempt();
+                return isDone || isCancelled.load();
+            });
+            numBlocked.fetch_sub(1u);
+        }
+
+        if (isDone) {
+            wakeBlocked();
+        }
+        return isDone;
+    };
+
+    /**
+     * Wakes the other side if it is blocked, after this side made progress.
+     */
+    void wakeBlocked() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (numBlocked.load(std::memory_order_relaxed) > 0u) {
+            std::lock_guard<std::mutex> blockLock(blockMutex);
+            blockCondition.notify_all();
+        }
+    };
+};
+
+}
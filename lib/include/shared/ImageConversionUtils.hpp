@@ -39,12 +39,23 @@ public:
 
     /** 
      * Converts the input image to a 3-channel BGR cv::Mat with uint8 pixels
-     * in the range of [0, 255] to represent a color image.
+     * in the range of [0, 255] to represent a color image.  Float32 pixels are
+     * expected in the range of [0.0f, 1.0f], uint8 pixels keep their values.
      * 
      * @param input The image to convert
      * @return The converted image
      */
     static cv::Mat convertToColorUint8(const cv::Mat& input);
+
+    /** 
+     * Same as above, but writes the converted image into an existing cv::Mat, which
+     * is only reallocated if its dimensions or type do not match.  The output may be
+     * the input itself if it already is a 3-channel uint8 image, which is left as is.
+     * 
+     * @param input The image to convert
+     * @param output Output converted image
+     */
+    static void copyToColorUint8(const cv::Mat& input, cv::Mat& output);
 private:
     /** 
      * Converts the input image to a 1-channel grayscale cv::Mat.
@@ -0,0 +1,64 @@
+/**
+ * Fixed-size pool of worker threads running tasks in the order they are submitted.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace shared {
+
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    // Tasks submitted but not yet started, in submission order
+    std::deque<std::function<void()>> pendingTasks;
+    // Indicator that the pool is being destroyed, so workers exit once no task is left
+    bool isStopping = false;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+public:
+    /** 
+     * Builds a new pool and starts its worker threads.
+     *
+     * @param numThreads Number of worker threads, must be at least 1
+     */
+    explicit ThreadPool(uint32_t numThreads);
+
+    /** 
+     * Runs every task still pending, then stops the worker threads.  Must not be
+     * called from a task.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /** 
+     * Submits a task to be run by the first worker thread available.
+     *
+     * @param task The task to run, which must not throw
+     */
+    void submit(const std::function<void()>& task);
+
+    /** 
+     * Gets the number of worker threads of the pool.
+     *
+     * @return The aforementioned number of worker threads
+     */
+    uint32_t getNumThreads() const;
+private:
+    /** 
+     * Runs the pending tasks one at a time until the pool is destroyed, the body of
+     * each worker thread.
+     */
+    void runWorker();
+};
+
+}
@@ -1,16 +1,29 @@
 #include "CorrespondenceFinder.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <limits>
 
+#include "shared/Definitions.hpp"
+
 #include "core/FeatureMatcher.hpp"
 
+Correspondences CorrespondenceFinder::execute(
+        const std::vector<core::FeatureVector>& sourceFeatureVectors,
+        const std::vector<core::FeatureVector>& targetFeatureVectors) const {
+    std::vector<float> matchQualities;
+    return execute(sourceFeatureVectors, targetFeatureVectors, matchQualities);
+}
+
 /**
  * Algorithm: Simple pairwise comparison algorithm.
  */
 Correspondences CorrespondenceFinder::execute(
         const std::vector<core::FeatureVector>& sourceFeatureVectors,
-        const std::vector<core::FeatureVector>& targetFeatureVectors) const {
+        const std::vector<core::FeatureVector>& targetFeatureVectors,
+        std::vector<float>& matchQualities) const {
     Correspondences correspondences;
+    matchQualities.clear();
     // No matches are possible if either input vector is empty.  Additionally,
     // we must enforce that target list has at least 2 elements so the algorithm
     // used to suppress non-discriminative matches is sensible.
@@ -18,10 +31,16 @@ Correspondences CorrespondenceFinder::execute(
         return correspondences;
     }
 
+    // Pre-allocate the best match of each source feature vector to facilitate
+    // easy parallelization
+    const uint32_t numSourceFeatures = sourceFeatureVectors.size();
+    std::vector<uint32_t> bestMatchIndices(numSourceFeatures);
+    std::vector<uint32_t> topDistanceGaps(numSourceFeatures);
+
     // Run pairwise comparison algorithm in parallel by parallelizing over source
     // feature vectors.
     #pragma omp parallel for schedule(static)
-    for (uint32_t iFeat1 = 0; iFeat1 < sourceFeatureVectors.size(); iFeat1++) {
+    for (uint32_t iFeat1 = 0; iFeat1 < numSourceFeatures; iFeat1++) {
         const core::FeatureVector& featureVector1 = sourceFeatureVectors[iFeat1];
 
         // Store the top two matches
@@ -41,25 +60,132 @@ Correspondences CorrespondenceFinder::execute(
             }
         }
 
-        // Non-discriminative match suppression
-        if (nextBestMatchDist - bestMatchDist >= minTopDistance) {
-            #pragma omp critical
-            {
-                correspondences.emplace_back(iFeat1, bestMatchIndex);
-            }
-        }
+        bestMatchIndices[iFeat1] = bestMatchIndex;
+        topDistanceGaps[iFeat1] = nextBestMatchDist - bestMatchDist;
     }
 
-    sortCorrespondences(correspondences);
+    // Non-discriminative match suppression, visiting source feature vectors in
+    // order keeps the correspondences sorted by source index
+    for (uint32_t iFeat1 = 0; iFeat1 < numSourceFeatures; iFeat1++) {
+        if (topDistanceGaps[iFeat1] >= minTopDistance) {
+            correspondences.emplace_back(iFeat1, bestMatchIndices[iFeat1]);
+            matchQualities.push_back((float)topDistanceGaps[iFeat1]);
+        }
+    }
 
     return correspondences;
 }
 
-void CorrespondenceFinder::sortCorrespondences(Correspondences& correspondences) const {
-    std::sort(correspondences.begin(), correspondences.end(),
-            [](const std::pair<uint32_t, uint32_t>& lhs,
-                    const std::pair<uint32_t, uint32_t>& rhs) {
-                return lhs.first < rhs.first;
-            });
-}
+/**
+ * Algorithm: The target keypoints are bucketed into a grid of cells as large as the
+ * search radius, by counting sort, so that each source feature vector only visits
+ * the 3x3 cells around its predicted position.
+ */
+Correspondences CorrespondenceFinder::execute(
+        const std::vector<core::FeatureVector>& sourceFeatureVectors,
+        const std::vector<cv::Point>& predictedKeypoints,
+        const std::vector<core::FeatureVector>& targetFeatureVectors,
+        const std::vector<cv::Point>& targetKeypoints, int32_t searchRadius,
+        std::vector<float>& matchQualities) const {
+    shared::VALIDATE_ARGUMENT(predictedKeypoints.size() == sourceFeatureVectors.size(),
+            "CorrespondenceFinder: Need one predicted keypoint per source feature vector");
+    shared::VALIDATE_ARGUMENT(targetKeypoints.size() == targetFeatureVectors.size(),
+            "CorrespondenceFinder: Need one target keypoint per target feature vector");
+    shared::VALIDATE_ARGUMENT(searchRadius > 0,
+            "CorrespondenceFinder: Search radius must be positive");
 
+    Correspondences correspondences;
+    matchQualities.clear();
+    if (sourceFeatureVectors.size() == 0 || targetFeatureVectors.size() == 0) {
+        return correspondences;
+    }
+
+    // Bucket the target keypoints into the grid covering their bounding box
+    cv::Point minKeypoint = targetKeypoints.front();
+    cv::Point maxKeypoint = targetKeypoints.front();
+    for (const cv::Point& targetKeypoint : targetKeypoints) {
+        minKeypoint.x = std::min(minKeypoint.x, targetKeypoint.x);
+        minKeypoint.y = std::min(minKeypoint.y, targetKeypoint.y);
+        maxKeypoint.x = std::max(maxKeypoint.x, targetKeypoint.x);
+        maxKeypoint.y = std::max(maxKeypoint.y, targetKeypoint.y);
+    }
+    const cv::Rect targetBounds(minKeypoint, maxKeypoint);
+    const int32_t numCols = targetBounds.width/searchRadius + 1;
+    const int32_t numRows = targetBounds.height/searchRadius + 1;
+    std::vector<uint32_t> cellStarts(numCols*numRows + 1, 0u);
+    std::vector<uint32_t> targetCells(targetKeypoints.size());
+    for (uint32_t iFeat2 = 0; iFeat2 < targetKeypoints.size(); iFeat2++) {
+        const cv::Point offset = targetKeypoints[iFeat2] - targetBounds.tl();
+        targetCells[iFeat2] = (offset.y/searchRadius)*numCols + offset.x/searchRadius;
+        cellStarts[targetCells[iFeat2] + 1]++;
+    }
+    for (uint32_t iCell = 1; iCell < cellStarts.size(); iCell++) {
+        cellStarts[iCell] += cellStarts[iCell - 1];
+    }
+    std::vector<uint32_t> cellTargetIndices(targetKeypoints.size());
+    std::vector<uint32_t> cellEnds(cellStarts.begin(), cellStarts.end() - 1);
+    for (uint32_t iFeat2 = 0; iFeat2 < targetKeypoints.size(); iFeat2++) {
+        cellTargetIndices[cellEnds[targetCells[iFeat2]]++] = iFeat2;
+    }
+
+    const uint32_t numSourceFeatures = sourceFeatureVectors.size();
+    std::vector<uint32_t> bestMatchIndices(numSourceFeatures);
+    std::vector<uint32_t> topDistanceGaps(numSourceFeatures, 0u);
+
+    #pragma omp parallel for schedule(static)
+    for (uint32_t iFeat1 = 0; iFeat1 < numSourceFeatures; iFeat1++) {
+        const core::FeatureVector& featureVector1 = sourceFeatureVectors[iFeat1];
+        const cv::Point& predictedKeypoint = predictedKeypoints[iFeat1];
+
+        // Cells overlapping the search window, clamped to the grid
+        const cv::Point offset = predictedKeypoint - targetBounds.tl();
+        const int32_t minCol = std::max(offset.x - searchRadius, 0)/searchRadius;
+        const int32_t maxCol = std::min(offset.x + searchRadius, targetBounds.width)/searchRadius;
+        const int32_t minRow = std::max(offset.y - searchRadius, 0)/searchRadius;
+        const int32_t maxRow = std::min(offset.y + searchRadius, targetBounds.height)/searchRadius;
+
+        // Without a second best match, the best one is measured against the max
+        // possible distance
+        uint32_t bestMatchDist = std::numeric_limits<uint32_t>::max();
+        uint32_t nextBestMatchDist = core::NUM_BRIEF_BITS;
+        uint32_t bestMatchIndex = 0;
+        for (int32_t row = minRow; row <= maxRow; row++) {
+            for (int32_t col = minCol; col <= maxCol; col++) {
+                const uint32_t iCell = row*numCols + col;
+                for (uint32_t iCellTarget = cellStarts[iCell];
+                        iCellTarget < cellStarts[iCell + 1]; iCellTarget++) {
+                    const uint32_t iFeat2 = cellTargetIndices[iCellTarget];
+                    const cv::Point displacement = targetKeypoints[iFeat2] - predictedKeypoint;
+                    if (std::abs(displacement.x) > searchRadius ||
+                            std::abs(displacement.y) > searchRadius) {
+                        continue;
+                    }
+
+                    const uint32_t distance = core::FeatureMatcher::execute(
+                            featureVector1, targetFeatureVectors[iFeat2]);
+                    if (distance <= bestMatchDist) {
+                        nextBestMatchDist = std::min(bestMatchDist, nextBestMatchDist);
+                        bestMatchDist = distance;
+                        bestMatchIndex = iFeat2;
+                    } else if (distance <= nextBestMatchDist) {
+                        nextBestMatchDist = distance;
+                    }
+                }
+            }
+        }
+
+        if (bestMatchDist <= nextBestMatchDist) {
+            bestMatchIndices[iFeat1] = bestMatchIndex;
+            topDistanceGaps[iFeat1] = nextBestMatchDist - bestMatchDist;
+        }
+    }
+
+    for (uint32_t iFeat1 = 0; iFeat1 < numSourceFeatures; iFeat1++) {
+        if (topDistanceGaps[iFeat1] >= minTopDistance) {
+            correspondences.emplace_back(iFeat1, bestMatchIndices[iFeat1]);
+            matchQualities.push_back((float)topDistanceGaps[iFeat1]);
+        }
+    }
+
+    return correspondences;
+}
@@ -23,6 +23,17 @@ MatchingPoints::MatchingPoints(const std::vector<cv::Point>& sourceKeypoints,
     }
 };
 
+MatchingPoints::MatchingPoints(const std::vector<cv::Point>& sourceKeypoints,
+        const std::vector<cv::Point>& targetKeypoints,
+        const Correspondences& correspondences,
+        const std::vector<float>& matchQualities) :
+        MatchingPoints(sourceKeypoints, targetKeypoints, correspondences) {
+    shared::VALIDATE_ARGUMENT(matchQualities.size() == correspondences.size(),
+            "MatchingPoints: there must be one quality score per correspondence");
+
+    qualities = matchQualities;
+}
+
 void MatchingPoints::validateCorrespondences(
         const std::vector<cv::Point>& sourceKeypoints,
         const std::vector<cv::Point>& targetKeypoints,
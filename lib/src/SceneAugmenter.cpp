@@ -12,7 +12,122 @@ void SceneAugmenter::setReplacementImage(const cv::Mat& newReplacementImage) {
     sceneAugmenterPri->setReplacementImage(newReplacementImage);
 }
 
+void SceneAugmenter::setReplacementImages(const std::vector<cv::Mat>& newReplacementImages) {
+    sceneAugmenterPri->setReplacementImages(newReplacementImages);
+}
+
+void SceneAugmenter::setMaxNumInstances(uint32_t newMaxNumInstances) {
+    sceneAugmenterPri->setMaxNumInstances(newMaxNumInstances);
+}
+
+void SceneAugmenter::setWarpCacheTolerance(float newMaxCornerDisplacement) {
+    sceneAugmenterPri->setWarpCacheTolerance(newMaxCornerDisplacement);
+}
+
+void SceneAugmenter::setTrackingMode(bool isEnabled) {
+    sceneAugmenterPri->setTrackingMode(isEnabled);
+}
+
+void SceneAugmenter::setKeyframeInterval(uint32_t newKeyframeInterval) {
+    sceneAugmenterPri->setKeyframeInterval(newKeyframeInterval);
+}
+
+void SceneAugmenter::setMinTrackedInliers(uint32_t newMinNumInliers) {
+    sceneAugmenterPri->setMinTrackedInliers(newMinNumInliers);
+}
+
 cv::Mat SceneAugmenter::execute(const cv::Mat& targetImage) const {
     return sceneAugmenterPri->execute(targetImage);
 }
 
+cv::Mat SceneAugmenter::execute(const cv::Mat& targetImage, Diagnostics& diagnostics) const {
+    return sceneAugmenterPri->execute(targetImage, diagnostics);
+}
+
+void SceneAugmenter::execute(const cv::Mat& targetImage, cv::Mat& outputImage) const {
+    sceneAugmenterPri->execute(targetImage, outputImage);
+}
+
+void SceneAugmenter::execute(const cv::Mat& targetImage, cv::Mat& outputImage,
+        Diagnostics& diagnostics) const {
+    sceneAugmenterPri->execute(targetImage, outputImage, diagnostics);
+}
+
+void SceneAugmenter::executeOverlay(const cv::Mat& targetImage, Overlay& overlay) const {
+    sceneAugmenterPri->executeOverlay(targetImage, overlay);
+}
+
+void SceneAugmenter::executeOverlay(const cv::Mat& targetImage, Overlay& overlay,
+        Diagnostics& diagnostics) const {
+    sceneAugmenterPri->executeOverlay(targetImage, overlay, diagnostics);
+}
+
+SceneAugmenter::Location SceneAugmenter::locate(const cv::Mat& targetImage) const {
+    return sceneAugmenterPri->locate(targetImage);
+}
+
+SceneAugmenter::Location SceneAugmenter::locate(const cv::Mat& targetImage,
+        Diagnostics& diagnostics) const {
+    return sceneAugmenterPri->locate(targetImage, diagnostics);
+}
+
+void SceneAugmenter::locate(const cv::Mat& targetImage, std::vector<Location>& locations,
+        Diagnostics& diagnostics) const {
+    sceneAugmenterPri->locate(targetImage, locations, diagnostics);
+}
+
+void SceneAugmenter::execute(const cv::Mat& targetImage,
+        std::vector<cv::Mat>& outputImages) const {
+    sceneAugmenterPri->execute(targetImage, outputImages);
+}
+
+void SceneAugmenter::execute(const cv::Mat& targetImage, std::vector<cv::Mat>& outputImages,
+        Diagnostics& diagnostics) const {
+    sceneAugmenterPri->execute(targetImage, outputImages, diagnostics);
+}
+
+void SceneAugmenter::executeOverlay(const cv::Mat& targetImage,
+        std::vector<Overlay>& overlays) const {
+    sceneAugmenterPri->executeOverlay(targetImage, overlays);
+}
+
+void SceneAugmenter::executeOverlay(const cv::Mat& targetImage, std::vector<Overlay>& overlays,
+        Diagnostics& diagnostics) const {
+    sceneAugmenterPri->executeOverlay(targetImage, overlays, diagnostics);
+}
+
+void SceneAugmenter::executeBatch(const std::function<bool(uint32_t, cv::Mat&)>& readFrame,
+        const std::function<void(uint32_t, const cv::Mat&)>& writeFrame,
+        uint32_t queueDepth) const {
+    sceneAugmenterPri->executeBatch(readFrame, writeFrame, queueDepth);
+}
+
+void SceneAugmenter::setSchedulingPolicy(SchedulingPolicy newSchedulingPolicy) {
+    sceneAugmenterPri->setSchedulingPolicy(newSchedulingPolicy);
+}
+
+void SceneAugmenter::setNumAsyncThreads(uint32_t newNumThreads) {
+    sceneAugmenterPri->setNumAsyncThreads(newNumThreads);
+}
+
+std::future<SceneAugmenter::AsyncResult> SceneAugmenter::executeAsync(
+        const cv::Mat& targetImage, const CancellationToken& cancellationToken) const {
+    return sceneAugmenterPri->executeAsync(targetImage, cancellationToken);
+}
+
+void SceneAugmenter::executeAsync(const cv::Mat& targetImage,
+        const std::function<void(const AsyncResult&)>& onComplete,
+        const CancellationToken& cancellationToken) const {
+    sceneAugmenterPri->executeAsync(targetImage, onComplete, cancellationToken);
+}
+
+SceneAugmenter::CancellationToken::CancellationToken() :
+        isCancelledFlag{new std::atomic<bool>(false)} {}
+
+void SceneAugmenter::CancellationToken::cancel() const {
+    isCancelledFlag->store(true);
+}
+
+bool SceneAugmenter::CancellationToken::isCancelled() const {
+    return isCancelledFlag->load();
+}
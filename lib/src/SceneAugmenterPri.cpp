@@ -1,5 +1,10 @@
 #include "SceneAugmenterPri.hpp"
 
+#include <algorithm>
+#include <exception>
+#include <omp.h>
+#include <thread>
+
 #include "opencv2/imgproc.hpp"
 
 #include "shared/ImageConversionUtils.hpp"
@@ -9,33 +14,455 @@
 void SceneAugmenterPri::setSourceImage(const cv::Mat& newSourceImage) {
     validateImage(newSourceImage);
     sourceImageDescription = buildImageDescription(newSourceImage);
+    buildReplacementPyramids();
+
+    // The tracked keypoints belong to the previous source image
+    std::lock_guard<std::mutex> trackingLock(guardedTrackingState->mutex);
+    guardedTrackingState->instances.clear();
 }
 
 void SceneAugmenterPri::setReplacementImage(const cv::Mat& newReplacementImage) {
-    validateImage(newReplacementImage);
-    replacementImageFloat = shared::ImageConversionUtils::convertToColorFloats(newReplacementImage);
+    setReplacementImages({newReplacementImage});
+}
+
+void SceneAugmenterPri::setReplacementImages(const std::vector<cv::Mat>& newReplacementImages) {
+    shared::VALIDATE_ARGUMENT(!newReplacementImages.empty(),
+            "SceneAugmenter: At least one replacement image is required");
+    for (const cv::Mat& newReplacementImage : newReplacementImages) {
+        validateImage(newReplacementImage);
+    }
+
+    replacementImagesColor.clear();
+    for (const cv::Mat& newReplacementImage : newReplacementImages) {
+        replacementImagesColor.push_back(
+                shared::ImageConversionUtils::convertToColorUint8(newReplacementImage));
+    }
+    buildReplacementPyramids();
+}
+
+void SceneAugmenterPri::setMaxNumInstances(uint32_t newMaxNumInstances) {
+    shared::VALIDATE_ARGUMENT(newMaxNumInstances >= 1u,
+            "SceneAugmenter: Max number of instances must be at least 1");
+    maxNumInstances = newMaxNumInstances;
+
+    std::lock_guard<std::mutex> trackingLock(guardedTrackingState->mutex);
+    guardedTrackingState->instances.clear();
+}
+
+void SceneAugmenterPri::setWarpCacheTolerance(float newMaxCornerDisplacement) {
+    shared::VALIDATE_ARGUMENT(newMaxCornerDisplacement >= 0.0f,
+            "SceneAugmenter: Warp cache tolerance can't be negative");
+    std::lock_guard<std::mutex> warpCacheLock(guardedWarpCaches->mutex);
+    guardedWarpCaches->maxCornerDisplacement = newMaxCornerDisplacement;
+    for (core::homography::Evaluator::WarpCache& warpCache : guardedWarpCaches->warpCaches) {
+        warpCache.maxCornerDisplacement = newMaxCornerDisplacement;
+    }
+}
+
+void SceneAugmenterPri::setTrackingMode(bool isEnabled) {
+    std::lock_guard<std::mutex> trackingLock(guardedTrackingState->mutex);
+    guardedTrackingState->isEnabled = isEnabled;
+    guardedTrackingState->instances.clear();
+}
+
+void SceneAugmenterPri::setKeyframeInterval(uint32_t newKeyframeInterval) {
+    shared::VALIDATE_ARGUMENT(newKeyframeInterval >= 1u,
+            "SceneAugmenter: Keyframe interval must be at least 1");
+    std::lock_guard<std::mutex> trackingLock(guardedTrackingState->mutex);
+    guardedTrackingState->keyframeInterval = newKeyframeInterval;
+}
+
+void SceneAugmenterPri::setMinTrackedInliers(uint32_t newMinNumInliers) {
+    shared::VALIDATE_ARGUMENT(newMinNumInliers >= core::homography::MIN_BUILD_POINTS,
+            "SceneAugmenter: Min number of tracked inliers must be enough to fit a homography");
+    std::lock_guard<std::mutex> trackingLock(guardedTrackingState->mutex);
+    guardedTrackingState->minNumInliers = newMinNumInliers;
+}
+
+cv::Mat SceneAugmenterPri::execute(const cv::Mat& targetImage) const {
+    SceneAugmenter::Diagnostics diagnostics;
+    return execute(targetImage, diagnostics);
+}
+
+cv::Mat SceneAugmenterPri::execute(const cv::Mat& targetImage,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    cv::Mat augmentedImage;
+    execute(targetImage, augmentedImage, diagnostics);
+
+    return augmentedImage;
+}
+
+void SceneAugmenterPri::execute(const cv::Mat& targetImage, cv::Mat& outputImage) const {
+    SceneAugmenter::Diagnostics diagnostics;
+    execute(targetImage, outputImage, diagnostics);
 }
 
 /**
  * Algorithm: Same pipeline as described in the README
  */
-cv::Mat SceneAugmenterPri::execute(const cv::Mat& targetImage) const {
-    validateImage(targetImage);
-    shared::VALIDATE_ARGUMENT(sourceImageDescription.size.area() > 0,
-            "SceneAugmenter: Source image is not set");
-    shared::VALIDATE_ARGUMENT(!replacementImageFloat.empty(),
-            "SceneAugmenter: Replacement image is not set");
+void SceneAugmenterPri::execute(const cv::Mat& targetImage, cv::Mat& outputImage,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point executeStartTime = std::chrono::steady_clock::now();
+    const std::vector<core::Transformation> transformations =
+            findInstancesToAugment(targetImage, diagnostics);
 
-    const ImageDescription targetImageDescription = buildImageDescription(targetImage);
+    // The target image is no longer read past this point, so the output may be the
+    // target image itself
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    shared::ImageConversionUtils::copyToColorUint8(targetImage, outputImage);
+    augment(outputImage, transformations, 0u);
+    diagnostics.augmentationTimeMs = getElapsedTimeMs(stageStartTime);
+    diagnostics.totalTimeMs = getElapsedTimeMs(executeStartTime);
+}
 
-    const Correspondences correspondences = correspondenceFinder.execute(
-            sourceImageDescription.featureVectors, targetImageDescription.featureVectors);
-    const MatchingPoints matchingPoints(sourceImageDescription.keypoints,
-            targetImageDescription.keypoints, correspondences);
-    const core::Transformation transformation = transformationFitter.execute(matchingPoints);
-    const cv::Mat augmentedImage = augment(targetImage, transformation);
+void SceneAugmenterPri::executeOverlay(const cv::Mat& targetImage,
+        SceneAugmenter::Overlay& overlay) const {
+    SceneAugmenter::Diagnostics diagnostics;
+    executeOverlay(targetImage, overlay, diagnostics);
+}
 
-    return augmentedImage;
+void SceneAugmenterPri::executeOverlay(const cv::Mat& targetImage,
+        SceneAugmenter::Overlay& overlay, SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point executeStartTime = std::chrono::steady_clock::now();
+    const std::vector<core::Transformation> transformations =
+            findInstancesToAugment(targetImage, diagnostics);
+
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    warpOverlay(targetImage.size(), transformations, 0u, overlay);
+    diagnostics.augmentationTimeMs = getElapsedTimeMs(stageStartTime);
+    diagnostics.totalTimeMs = getElapsedTimeMs(executeStartTime);
+}
+
+SceneAugmenter::Location SceneAugmenterPri::locate(const cv::Mat& targetImage) const {
+    SceneAugmenter::Diagnostics diagnostics;
+    return locate(targetImage, diagnostics);
+}
+
+SceneAugmenter::Location SceneAugmenterPri::locate(const cv::Mat& targetImage,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    std::vector<SceneAugmenter::Location> locations;
+    locate(targetImage, locations, diagnostics);
+
+    return locations.empty() ? SceneAugmenter::Location() : locations.front();
+}
+
+void SceneAugmenterPri::locate(const cv::Mat& targetImage,
+        std::vector<SceneAugmenter::Location>& locations,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point executeStartTime = std::chrono::steady_clock::now();
+    const std::vector<TransformationFitter::FitResult> fitResults =
+            findInstances(targetImage, diagnostics);
+
+    // Same sanity checks as augmentation, without compositing anything
+    locations.clear();
+    for (const TransformationFitter::FitResult& fitResult : fitResults) {
+        SceneAugmenter::Location location;
+        location.isValid = fitResult.transformation.isAugmentationSane(targetImage.size(),
+                sourceImageDescription.size);
+        location.homography = fitResult.transformation.getHomography();
+        location.corners = fitResult.transformation.projectCorners(sourceImageDescription.size);
+        location.numInliers = fitResult.numInliers;
+        locations.push_back(location);
+    }
+    diagnostics.totalTimeMs = getElapsedTimeMs(executeStartTime);
+}
+
+void SceneAugmenterPri::execute(const cv::Mat& targetImage,
+        std::vector<cv::Mat>& outputImages) const {
+    SceneAugmenter::Diagnostics diagnostics;
+    execute(targetImage, outputImages, diagnostics);
+}
+
+void SceneAugmenterPri::execute(const cv::Mat& targetImage, std::vector<cv::Mat>& outputImages,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point executeStartTime = std::chrono::steady_clock::now();
+    const std::vector<core::Transformation> transformations =
+            findInstancesToAugment(targetImage, diagnostics);
+
+    // The instances are found once, then each replacement image augments its own copy
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    outputImages.resize(replacementPyramids.size());
+    for (uint32_t iReplacement = 0; iReplacement < replacementPyramids.size(); iReplacement++) {
+        shared::ImageConversionUtils::copyToColorUint8(targetImage, outputImages[iReplacement]);
+        augment(outputImages[iReplacement], transformations, iReplacement);
+    }
+    diagnostics.augmentationTimeMs = getElapsedTimeMs(stageStartTime);
+    diagnostics.totalTimeMs = getElapsedTimeMs(executeStartTime);
+}
+
+void SceneAugmenterPri::executeOverlay(const cv::Mat& targetImage,
+        std::vector<SceneAugmenter::Overlay>& overlays) const {
+    SceneAugmenter::Diagnostics diagnostics;
+    executeOverlay(targetImage, overlays, diagnostics);
+}
+
+void SceneAugmenterPri::executeOverlay(const cv::Mat& targetImage,
+        std::vector<SceneAugmenter::Overlay>& overlays,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point executeStartTime = std::chrono::steady_clock::now();
+    const std::vector<core::Transformation> transformations =
+            findInstancesToAugment(targetImage, diagnostics);
+
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    overlays.resize(replacementPyramids.size());
+    for (uint32_t iReplacement = 0; iReplacement < replacementPyramids.size(); iReplacement++) {
+        warpOverlay(targetImage.size(), transformations, iReplacement, overlays[iReplacement]);
+    }
+    diagnostics.augmentationTimeMs = getElapsedTimeMs(stageStartTime);
+    diagnostics.totalTimeMs = getElapsedTimeMs(executeStartTime);
+}
+
+/**
+ * Algorithm: Each stage of the pipeline runs on its own thread(s), on one frame at a
+ * time, and hands it to the next stage through bounded queues.  A stage run by several
+ * threads deals the frames out to them in turn, and the next stage collects them in the
+ * same turn, so frames come out in order, and a null frame marks the end of the stream.
+ * The first error raised by any stage cancels the whole pipeline, and is rethrown once
+ * every stage has stopped.
+ */
+void SceneAugmenterPri::executeBatch(const std::function<bool(uint32_t, cv::Mat&)>& readFrame,
+        const std::function<void(uint32_t, const cv::Mat&)>& writeFrame,
+        uint32_t queueDepth) const {
+    validateReplacementImages();
+    shared::VALIDATE_ARGUMENT(queueDepth >= 1u,
+            "SceneAugmenter: Queue depth must be at least 1");
+
+    const std::function<bool(BatchFrame&)> decode = [&](BatchFrame& frame) {
+        return readFrame(frame.iFrame, frame.targetImage);
+    };
+    const std::function<bool(BatchFrame&)> analyze = [&](BatchFrame& frame) {
+        validateImage(frame.targetImage);
+        describeTarget(frame.targetImage, frame.search, frame.diagnostics);
+        return true;
+    };
+    const std::function<bool(BatchFrame&)> match = [&](BatchFrame& frame) {
+        matchTarget(frame.search, frame.diagnostics);
+        return true;
+    };
+    const std::function<bool(BatchFrame&)> fit = [&](BatchFrame& frame) {
+        fitTarget(frame.targetImage.size(), frame.search, frame.diagnostics);
+        return true;
+    };
+    const std::function<bool(BatchFrame&)> composite = [&](BatchFrame& frame) {
+        std::vector<core::Transformation> transformations;
+        for (const TransformationFitter::FitResult& fitResult : frame.search.fitResults) {
+            transformations.push_back(fitResult.transformation);
+        }
+        shared::ImageConversionUtils::copyToColorUint8(frame.targetImage, frame.outputImage);
+        augment(frame.outputImage, transformations, 0u);
+
+        // Release the intermediate results before the frame waits to be encoded
+        frame.targetImage.release();
+        frame.search = TargetSearch();
+        return true;
+    };
+    const std::function<bool(BatchFrame&)> encode = [&](BatchFrame& frame) {
+        writeFrame(frame.iFrame, frame.outputImage);
+        return true;
+    };
+
+    // In throughput mode, the search stages run together on one thread per core, each
+    // on its own frames, while compositing stays in frame order so that the warp caches
+    // see the frames in the same order as in latency mode
+    std::vector<BatchStage> stages;
+    if (schedulingPolicy == SceneAugmenter::SchedulingPolicy::THROUGHPUT) {
+        const std::function<bool(BatchFrame&)> search = [&](BatchFrame& frame) {
+            return analyze(frame) && match(frame) && fit(frame);
+        };
+        stages = {{decode, 1u}, {search, getNumCores()}, {composite, 1u}, {encode, 1u}};
+    } else {
+        stages = {{decode, 1u}, {analyze, 1u}, {match, 1u}, {fit, 1u}, {composite, 1u},
+                {encode, 1u}};
+    }
+
+    // Consecutive stages are connected by as many queues as the widest of them has
+    // threads, held by pointer since the queues can't be moved
+    std::vector<std::unique_ptr<BatchQueue>> queues;
+    std::vector<std::vector<BatchQueue*>> stageInputQueues(stages.size());
+    std::vector<std::vector<BatchQueue*>> stageOutputQueues(stages.size());
+    for (uint32_t iStage = 0; iStage + 1u < stages.size(); iStage++) {
+        const uint32_t numQueues = std::max(stages[iStage].numThreads,
+                stages[iStage + 1u].numThreads);
+        for (uint32_t iQueue = 0; iQueue < numQueues; iQueue++) {
+            queues.emplace_back(new BatchQueue(queueDepth));
+            stageOutputQueues[iStage].push_back(queues.back().get());
+            stageInputQueues[iStage + 1u].push_back(queues.back().get());
+        }
+    }
+
+    std::atomic<bool> isCancelled(false);
+    std::exception_ptr firstError;
+    std::mutex errorMutex;
+    std::vector<std::thread> stageThreads;
+    for (uint32_t iStage = 0; iStage < stages.size(); iStage++) {
+        const uint32_t numThreads = stages[iStage].numThreads;
+        for (uint32_t iThread = 0; iThread < numThreads; iThread++) {
+            // Each thread of a stage has its own queue on the side(s) it is wider
+            std::vector<BatchQueue*> inputQueues = stageInputQueues[iStage];
+            std::vector<BatchQueue*> outputQueues = stageOutputQueues[iStage];
+            if (numThreads > 1u) {
+                inputQueues = {inputQueues[iThread]};
+                outputQueues = {outputQueues[iThread]};
+            }
+
+            stageThreads.emplace_back([&, inputQueues, outputQueues, iStage]() {
+                try {
+                    const SerialKernelsGuard serialKernelsGuard(
+                            schedulingPolicy == SceneAugmenter::SchedulingPolicy::THROUGHPUT);
+                    runBatchStage(inputQueues, outputQueues, stages[iStage].processFrame,
+                            isCancelled);
+                } catch (...) {
+                    std::lock_guard<std::mutex> errorLock(errorMutex);
+                    if (!firstError) {
+                        firstError = std::current_exception();
+                    }
+                    isCancelled = true;
+                    for (const std::unique_ptr<BatchQueue>& queue : queues) {
+                        queue->wakeAll();
+                    }
+                }
+            });
+        }
+    }
+    for (std::thread& stageThread : stageThreads) {
+        stageThread.join();
+    }
+
+    if (firstError) {
+        std::rethrow_exception(firstError);
+    }
+}
+
+void SceneAugmenterPri::setNumAsyncThreads(uint32_t newNumThreads) {
+    shared::VALIDATE_ARGUMENT(newNumThreads >= 1u,
+            "SceneAugmenter: Number of async threads must be at least 1");
+
+    // The previous pool completes its calls outside of the lock, so that they may
+    // submit new calls meanwhile
+    std::unique_ptr<shared::ThreadPool> previousThreadPool;
+    {
+        std::lock_guard<std::mutex> threadPoolLock(guardedThreadPool->mutex);
+        guardedThreadPool->numThreads = newNumThreads;
+        previousThreadPool = std::move(guardedThreadPool->threadPool);
+    }
+}
+
+void SceneAugmenterPri::setSchedulingPolicy(
+        SceneAugmenter::SchedulingPolicy newSchedulingPolicy) {
+    // The calls already submitted read the policy, so they complete under the previous
+    // one before it changes.  The default number of async threads depends on the
+    // policy, so the pool is rebuilt on the next call
+    std::unique_ptr<shared::ThreadPool> previousThreadPool;
+    {
+        std::lock_guard<std::mutex> threadPoolLock(guardedThreadPool->mutex);
+        previousThreadPool = std::move(guardedThreadPool->threadPool);
+    }
+    previousThreadPool.reset();
+
+    schedulingPolicy = newSchedulingPolicy;
+}
+
+std::future<SceneAugmenter::AsyncResult> SceneAugmenterPri::executeAsync(
+        const cv::Mat& targetImage,
+        const SceneAugmenter::CancellationToken& cancellationToken) const {
+    // Held by pointer since the callback must be copyable
+    const std::shared_ptr<std::promise<SceneAugmenter::AsyncResult>> resultPromise(
+            new std::promise<SceneAugmenter::AsyncResult>());
+    std::future<SceneAugmenter::AsyncResult> futureResult = resultPromise->get_future();
+    executeAsync(targetImage, [resultPromise](const SceneAugmenter::AsyncResult& result) {
+        if (result.error) {
+            resultPromise->set_exception(result.error);
+        } else {
+            resultPromise->set_value(result);
+        }
+    }, cancellationToken);
+
+    return futureResult;
+}
+
+void SceneAugmenterPri::executeAsync(const cv::Mat& targetImage,
+        const std::function<void(const SceneAugmenter::AsyncResult&)>& onComplete,
+        const SceneAugmenter::CancellationToken& cancellationToken) const {
+    shared::VALIDATE_ARGUMENT(static_cast<bool>(onComplete),
+            "SceneAugmenter: Completion callback is not set");
+
+    std::lock_guard<std::mutex> threadPoolLock(guardedThreadPool->mutex);
+    if (!guardedThreadPool->threadPool) {
+        // Throughput mode runs one call per core instead of few calls on all cores
+        uint32_t numThreads = guardedThreadPool->numThreads;
+        if (numThreads == 0u) {
+            numThreads =
+                    (schedulingPolicy == SceneAugmenter::SchedulingPolicy::THROUGHPUT) ?
+                    getNumCores() : defaultNumAsyncThreads;
+        }
+        guardedThreadPool->threadPool.reset(new shared::ThreadPool(numThreads));
+    }
+    guardedThreadPool->threadPool->submit([this, targetImage, onComplete, cancellationToken]() {
+        // Errors are handed to the callback, since nothing else can catch them
+        SceneAugmenter::AsyncResult result;
+        try {
+            runAsync(targetImage, cancellationToken, result);
+        } catch (...) {
+            result.outputImage.release();
+            result.error = std::current_exception();
+        }
+
+        // Tasks of the pool must not throw, and the caller has no way to handle the
+        // errors of its own callback from here
+        try {
+            onComplete(result);
+        } catch (...) {}
+    });
+}
+
+TransformationFitter::Params SceneAugmenterPri::buildTransformationFitterParams() {
+    // Correspondences come with match qualities, so prefer the best ones first, most
+    // hypotheses are bad so reject them early, and keypoints are noisy so refine
+    // the good ones from their inliers
+    TransformationFitter::Params params;
+    params.sampler = TransformationFitter::Sampler::PROSAC;
+    params.sprt = true;
+    params.localOptimization = true;
+
+    return params;
+}
+
+TransformationFitter::Params SceneAugmenterPri::buildTrackingFitterParams() {
+    // Few matches, mostly inliers, so a small budget suffices and early rejection
+    // has little to save
+    TransformationFitter::Params params = buildTransformationFitterParams();
+    params.maxIters = trackingMaxIters;
+    params.sprt = false;
+
+    return params;
+}
+
+std::vector<uint32_t> SceneAugmenterPri::findInliers(const MatchingPoints& matchingPoints,
+        const core::Transformation& transformation) {
+    const float epsilon = buildTransformationFitterParams().epsilon;
+    const std::vector<cv::Point> projectedPts = transformation.apply(matchingPoints.fromPts);
+
+    std::vector<uint32_t> inlierIndices;
+    for (uint32_t iMatch = 0; iMatch < projectedPts.size(); iMatch++) {
+        const cv::Point displacement = projectedPts[iMatch] - matchingPoints.toPts[iMatch];
+        if (displacement.dot(displacement) <= epsilon*epsilon) {
+            inlierIndices.push_back(iMatch);
+        }
+    }
+
+    return inlierIndices;
+}
+
+uint32_t SceneAugmenterPri::getNumCores() {
+    // May be unknown, in which case it is 0
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+double SceneAugmenterPri::getElapsedTimeMs(
+        const std::chrono::steady_clock::time_point& startTime) {
+    const std::chrono::duration<double, std::milli> elapsedTime =
+            std::chrono::steady_clock::now() - startTime;
+    return elapsedTime.count();
 }
 
 void SceneAugmenterPri::validateImage(const cv::Mat& image) const {
@@ -57,18 +484,345 @@ SceneAugmenterPri::ImageDescription SceneAugmenterPri::buildImageDescription(
     return imageDescription;
 }
 
-cv::Mat SceneAugmenterPri::augment(const cv::Mat& targetImage,
-        const core::Transformation& transformation) const {
-    // Skew the replacement image so it will fit exactly on to the found source object
-    cv::Mat scaledReplacementImageFloat;
-    cv::resize(replacementImageFloat, scaledReplacementImageFloat, sourceImageDescription.size);
+void SceneAugmenterPri::validateReplacementImages() const {
+    shared::VALIDATE_ARGUMENT(sourceImageDescription.size.area() > 0,
+            "SceneAugmenter: Source image is not set");
+    shared::VALIDATE_ARGUMENT(!replacementPyramids.empty(),
+            "SceneAugmenter: Replacement image is not set");
+}
+
+/**
+ * Algorithm: Keyframes search the whole target image, and the calls in between track
+ * the instances of the previous call, which falls back to a keyframe as soon as any
+ * instance keeps too few inliers.
+ */
+std::vector<TransformationFitter::FitResult> SceneAugmenterPri::findInstances(
+        const cv::Mat& targetImage, SceneAugmenter::Diagnostics& diagnostics) const {
+    validateImage(targetImage);
+    shared::VALIDATE_ARGUMENT(sourceImageDescription.size.area() > 0,
+            "SceneAugmenter: Source image is not set");
+
+    diagnostics = SceneAugmenter::Diagnostics();
+    const SerialKernelsGuard serialKernelsGuard(
+            schedulingPolicy == SceneAugmenter::SchedulingPolicy::THROUGHPUT);
 
-    // Perform augmentation in the color float32 space
-    const cv::Mat targetImageFloat = shared::ImageConversionUtils::convertToColorFloats(targetImage);
-    const cv::Mat augmentedImageFloat = transformation.augment(
-            targetImageFloat, scaledReplacementImageFloat);
-    const cv::Mat augmentedImage = shared::ImageConversionUtils::convertToColorUint8(augmentedImageFloat);
+    // Independent calls don't share any state, so they may run concurrently
+    std::unique_lock<std::mutex> trackingLock(guardedTrackingState->mutex);
+    GuardedTrackingState& trackingState = *guardedTrackingState;
+    if (!trackingState.isEnabled) {
+        trackingLock.unlock();
+        return detectInstances(targetImage, diagnostics);
+    }
 
-    return augmentedImage;
+    const bool isKeyframe = trackingState.instances.empty() ||
+            trackingState.numTrackedFrames + 1u >= trackingState.keyframeInterval;
+    if (!isKeyframe) {
+        const std::vector<TransformationFitter::FitResult> fitResults = trackInstances(
+                targetImage, trackingState.minNumInliers, trackingState.instances,
+                diagnostics);
+        if (!fitResults.empty()) {
+            trackingState.numTrackedFrames++;
+            return fitResults;
+        }
+    }
+
+    diagnostics = SceneAugmenter::Diagnostics();
+    trackingState.numTrackedFrames = 0u;
+    return detectInstances(targetImage, diagnostics, &trackingState.instances);
 }
 
+std::vector<TransformationFitter::FitResult> SceneAugmenterPri::detectInstances(
+        const cv::Mat& targetImage, SceneAugmenter::Diagnostics& diagnostics,
+        std::vector<TrackedInstance>* trackedInstances) const {
+    TargetSearch search;
+    describeTarget(targetImage, search, diagnostics);
+    matchTarget(search, diagnostics);
+    fitTarget(targetImage.size(), search, diagnostics);
+
+    if (trackedInstances != nullptr) {
+        trackedInstances->clear();
+        for (const TransformationFitter::FitResult& fitResult : search.fitResults) {
+            TrackedInstance trackedInstance;
+            trackedInstance.transformation = fitResult.transformation;
+            for (const uint32_t iMatch :
+                    findInliers(search.matchingPoints, fitResult.transformation)) {
+                trackedInstance.sourceIndices.push_back(search.correspondences[iMatch].first);
+            }
+            trackedInstances->push_back(trackedInstance);
+        }
+    }
+
+    return search.fitResults;
+}
+
+void SceneAugmenterPri::describeTarget(const cv::Mat& targetImage, TargetSearch& search,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    search.targetImageDescription = buildImageDescription(targetImage);
+    diagnostics.targetDescriptionTimeMs = getElapsedTimeMs(stageStartTime);
+}
+
+void SceneAugmenterPri::matchTarget(TargetSearch& search,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    std::vector<float> matchQualities;
+    search.correspondences = correspondenceFinder.execute(
+            sourceImageDescription.featureVectors,
+            search.targetImageDescription.featureVectors, matchQualities);
+    search.matchingPoints = MatchingPoints(sourceImageDescription.keypoints,
+            search.targetImageDescription.keypoints, search.correspondences, matchQualities);
+    diagnostics.correspondenceTimeMs = getElapsedTimeMs(stageStartTime);
+}
+
+void SceneAugmenterPri::fitTarget(const cv::Size& targetSize, TargetSearch& search,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    search.fitResults = transformationFitter.fitMultiple(search.matchingPoints, maxNumInstances);
+    diagnostics.fitTimeMs = getElapsedTimeMs(stageStartTime);
+
+    fillFitDiagnostics(search.fitResults, targetSize,
+            search.targetImageDescription.keypoints.size(), search.correspondences.size(),
+            diagnostics);
+}
+
+void SceneAugmenterPri::runAsync(const cv::Mat& targetImage,
+        const SceneAugmenter::CancellationToken& cancellationToken,
+        SceneAugmenter::AsyncResult& result) const {
+    if (cancellationToken.isCancelled()) {
+        result.isCancelled = true;
+        return;
+    }
+
+    const std::chrono::steady_clock::time_point executeStartTime = std::chrono::steady_clock::now();
+    const std::vector<core::Transformation> transformations =
+            findInstancesToAugment(targetImage, result.diagnostics);
+    if (cancellationToken.isCancelled()) {
+        result.isCancelled = true;
+        return;
+    }
+
+    const std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+    shared::ImageConversionUtils::copyToColorUint8(targetImage, result.outputImage);
+    augment(result.outputImage, transformations, 0u);
+    result.diagnostics.augmentationTimeMs = getElapsedTimeMs(stageStartTime);
+    result.diagnostics.totalTimeMs = getElapsedTimeMs(executeStartTime);
+}
+
+void SceneAugmenterPri::runBatchStage(const std::vector<BatchQueue*>& inputQueues,
+        const std::vector<BatchQueue*>& outputQueues,
+        const std::function<bool(BatchFrame&)>& processFrame,
+        const std::atomic<bool>& isCancelled) {
+    for (uint32_t iFrame = 0; !isCancelled.load(); iFrame++) {
+        std::unique_ptr<BatchFrame> frame;
+        if (inputQueues.empty()) {
+            frame.reset(new BatchFrame());
+            frame->iFrame = iFrame;
+        } else if (!inputQueues[iFrame % inputQueues.size()]->pop(frame, isCancelled)) {
+            return;
+        }
+
+        if (frame && !processFrame(*frame)) {
+            frame.reset();
+        }
+
+        // The end of the stream is forwarded to every next thread
+        if (!frame) {
+            for (BatchQueue* outputQueue : outputQueues) {
+                std::unique_ptr<BatchFrame> endOfStream;
+                if (!outputQueue->push(endOfStream, isCancelled)) {
+                    return;
+                }
+            }
+            return;
+        }
+        if (!outputQueues.empty() &&
+                !outputQueues[iFrame % outputQueues.size()]->push(frame, isCancelled)) {
+            return;
+        }
+    }
+}
+
+/**
+ * Algorithm: The target image is only described around the predicted keypoints, then
+ * each instance is refit on its own from the local matches of its keypoints with a
+ * small RANSAC budget.
+ */
+std::vector<TransformationFitter::FitResult> SceneAugmenterPri::trackInstances(
+        const cv::Mat& targetImage, uint32_t minNumInliers,
+        std::vector<TrackedInstance>& trackedInstances,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    std::chrono::steady_clock::time_point stageStartTime = std::chrono::steady_clock::now();
+
+    // Predict where the inliers of the previous call land in the target image
+    std::vector<std::vector<cv::Point>> sourceKeypoints(trackedInstances.size());
+    std::vector<std::vector<cv::Point>> predictedKeypoints(trackedInstances.size());
+    cv::Rect searchRegion;
+    for (uint32_t iInstance = 0; iInstance < trackedInstances.size(); iInstance++) {
+        for (const uint32_t iSource : trackedInstances[iInstance].sourceIndices) {
+            sourceKeypoints[iInstance].push_back(sourceImageDescription.keypoints[iSource]);
+        }
+        trackedInstances[iInstance].transformation.apply(sourceKeypoints[iInstance],
+                predictedKeypoints[iInstance]);
+        if (predictedKeypoints[iInstance].size() < minNumInliers) {
+            return {};
+        }
+        const cv::Rect instanceRegion = cv::boundingRect(predictedKeypoints[iInstance]);
+        searchRegion = (iInstance == 0u) ? instanceRegion : (searchRegion | instanceRegion);
+    }
+    searchRegion = cv::Rect(searchRegion.x - trackingSearchRadius,
+            searchRegion.y - trackingSearchRadius,
+            searchRegion.width + 2*trackingSearchRadius,
+            searchRegion.height + 2*trackingSearchRadius) &
+            cv::Rect(cv::Point(0, 0), targetImage.size());
+
+    // Only describe the target keypoints within reach of a prediction
+    const cv::Mat image = shared::ImageConversionUtils::convertToGrayFloats(targetImage);
+    std::vector<cv::Point> targetKeypoints;
+    for (const cv::Point& keypoint : keypointDetector.execute(image)) {
+        if (searchRegion.contains(keypoint)) {
+            targetKeypoints.push_back(keypoint);
+        }
+    }
+    const std::vector<core::FeatureVector> targetFeatureVectors =
+            sceneFeatureExtractor.execute(image, targetKeypoints);
+    diagnostics.targetDescriptionTimeMs = getElapsedTimeMs(stageStartTime);
+
+    std::vector<TrackedInstance> refitInstances(trackedInstances.size());
+    std::vector<TransformationFitter::FitResult> fitResults;
+    uint32_t numCorrespondences = 0u;
+    for (uint32_t iInstance = 0; iInstance < trackedInstances.size(); iInstance++) {
+        const std::vector<uint32_t>& sourceIndices = trackedInstances[iInstance].sourceIndices;
+
+        stageStartTime = std::chrono::steady_clock::now();
+        std::vector<core::FeatureVector> sourceFeatureVectors;
+        for (const uint32_t iSource : sourceIndices) {
+            sourceFeatureVectors.push_back(sourceImageDescription.featureVectors[iSource]);
+        }
+        std::vector<float> matchQualities;
+        const Correspondences correspondences = correspondenceFinder.execute(
+                sourceFeatureVectors, predictedKeypoints[iInstance], targetFeatureVectors,
+                targetKeypoints, trackingSearchRadius, matchQualities);
+        const MatchingPoints matchingPoints(sourceKeypoints[iInstance], targetKeypoints,
+                correspondences, matchQualities);
+        numCorrespondences += correspondences.size();
+        diagnostics.correspondenceTimeMs += getElapsedTimeMs(stageStartTime);
+
+        stageStartTime = std::chrono::steady_clock::now();
+        const TransformationFitter::FitResult fitResult = trackingFitter.fit(matchingPoints);
+        diagnostics.fitTimeMs += getElapsedTimeMs(stageStartTime);
+        if (!fitResult.transformation.isValid() || fitResult.numInliers < minNumInliers) {
+            return {};
+        }
+
+        // Only the keypoints still consistent with the instance are tracked further,
+        // so the instance is lost once too many have drifted away
+        refitInstances[iInstance].transformation = fitResult.transformation;
+        for (const uint32_t iMatch : findInliers(matchingPoints, fitResult.transformation)) {
+            refitInstances[iInstance].sourceIndices.push_back(
+                    sourceIndices[correspondences[iMatch].first]);
+        }
+        fitResults.push_back(fitResult);
+    }
+
+    trackedInstances = refitInstances;
+    fillFitDiagnostics(fitResults, targetImage.size(), targetKeypoints.size(),
+            numCorrespondences, diagnostics);
+    diagnostics.isTracked = true;
+    return fitResults;
+}
+
+void SceneAugmenterPri::fillFitDiagnostics(
+        const std::vector<TransformationFitter::FitResult>& fitResults,
+        const cv::Size& targetSize, uint32_t numTargetKeypoints, uint32_t numCorrespondences,
+        SceneAugmenter::Diagnostics& diagnostics) const {
+    diagnostics.numSourceKeypoints = sourceImageDescription.keypoints.size();
+    diagnostics.numTargetKeypoints = numTargetKeypoints;
+    diagnostics.numCorrespondences = numCorrespondences;
+    diagnostics.numInstances = fitResults.size();
+    for (const TransformationFitter::FitResult& fitResult : fitResults) {
+        diagnostics.numInliers += fitResult.numInliers;
+        diagnostics.numIters += fitResult.numIters;
+        diagnostics.maxIters += fitResult.maxIters;
+        diagnostics.isAugmentationRejected = diagnostics.isAugmentationRejected ||
+                !fitResult.transformation.isAugmentationSane(targetSize,
+                        sourceImageDescription.size);
+    }
+    diagnostics.inlierRatio = (diagnostics.numCorrespondences > 0u) ?
+            (float)diagnostics.numInliers/(float)diagnostics.numCorrespondences : 0.0f;
+    diagnostics.isTransformationFound = !fitResults.empty();
+}
+
+std::vector<core::Transformation> SceneAugmenterPri::findInstancesToAugment(
+        const cv::Mat& targetImage, SceneAugmenter::Diagnostics& diagnostics) const {
+    validateReplacementImages();
+
+    std::vector<core::Transformation> transformations;
+    for (const TransformationFitter::FitResult& fitResult :
+            findInstances(targetImage, diagnostics)) {
+        transformations.push_back(fitResult.transformation);
+    }
+
+    return transformations;
+}
+
+void SceneAugmenterPri::buildReplacementPyramids() {
+    replacementPyramids.clear();
+    if (sourceImageDescription.size.area() > 0) {
+        // Skew the replacement images so they will fit exactly on to the found source object
+        for (const cv::Mat& replacementImageColor : replacementImagesColor) {
+            cv::Mat scaledReplacementImage;
+            cv::resize(replacementImageColor, scaledReplacementImage,
+                    sourceImageDescription.size);
+            replacementPyramids.push_back(
+                    core::Transformation::buildReplacementPyramid(scaledReplacementImage));
+        }
+    }
+
+    std::lock_guard<std::mutex> warpCacheLock(guardedWarpCaches->mutex);
+    guardedWarpCaches->warpCaches.assign(replacementPyramids.size(),
+            core::homography::Evaluator::WarpCache(guardedWarpCaches->maxCornerDisplacement));
+}
+
+void SceneAugmenterPri::augment(cv::Mat& image,
+        const std::vector<core::Transformation>& transformations, uint32_t iReplacement) const {
+    // Perform augmentation in place in the color uint8 space, which only touches
+    // the pixels the replacement image lands on
+    const SerialKernelsGuard serialKernelsGuard(
+            schedulingPolicy == SceneAugmenter::SchedulingPolicy::THROUGHPUT);
+    std::lock_guard<std::mutex> warpCacheLock(guardedWarpCaches->mutex);
+    core::Transformation::augmentInPlace(image, replacementPyramids[iReplacement],
+            transformations, &guardedWarpCaches->warpCaches[iReplacement]);
+}
+
+void SceneAugmenterPri::warpOverlay(const cv::Size& imageSize,
+        const std::vector<core::Transformation>& transformations, uint32_t iReplacement,
+        SceneAugmenter::Overlay& overlay) const {
+    const SerialKernelsGuard serialKernelsGuard(
+            schedulingPolicy == SceneAugmenter::SchedulingPolicy::THROUGHPUT);
+    std::lock_guard<std::mutex> warpCacheLock(guardedWarpCaches->mutex);
+    core::homography::Evaluator::WarpCache& warpCache =
+            guardedWarpCaches->warpCaches[iReplacement];
+    if (!core::Transformation::warp(imageSize, replacementPyramids[iReplacement],
+            transformations, warpCache) || warpCache.region.area() == 0) {
+        overlay = SceneAugmenter::Overlay();
+        return;
+    }
+
+    // The cache is overwritten by later calls, so the overlay gets its own copy of
+    // the (small) warped region
+    overlay.region = warpCache.region;
+    warpCache.warpedRegion.copyTo(overlay.patch);
+    warpCache.coverageMask.copyTo(overlay.mask);
+}
+
+SceneAugmenterPri::SerialKernelsGuard::SerialKernelsGuard(bool isSerial) :
+        prevMaxNumThreads(omp_get_max_threads()) {
+    // Only affects the parallel regions started by the current thread
+    if (isSerial) {
+        omp_set_num_threads(1);
+    }
+}
+
+SceneAugmenterPri::SerialKernelsGuard::~SerialKernelsGuard() {
+    omp_set_num_threads(prevMaxNumThreads);
+}
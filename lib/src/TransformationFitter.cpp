@@ -1,84 +1,738 @@
 #include "TransformationFitter.hpp"
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "shared/Definitions.hpp"
+#include "shared/RandomNumberGenerator.hpp"
 
 #include "core/homography/Definitions.hpp"
+#include "core/homography/InlierCounter.hpp"
+#include "core/homography/SanityChecker.hpp"
+
+TransformationFitter::TransformationFitter(const Params& _params) : params(_params) {
+    shared::VALIDATE_ARGUMENT(params.confidence > 0.0f && params.confidence <= 1.0f,
+            "TransformationFitter: confidence must be in the range (0.0f, 1.0f]");
+    shared::VALIDATE_ARGUMENT(params.napsacRadius >= 1.0f,
+            "TransformationFitter: napsacRadius must be at least 1 pixel");
+    shared::VALIDATE_ARGUMENT(params.itersPerBatch >= 1u &&
+            params.itersPerBatch <= MAX_ITERS_PER_BATCH,
+            "TransformationFitter: itersPerBatch must be in the range [1, MAX_ITERS_PER_BATCH]");
+}
+
+core::Transformation TransformationFitter::execute(const MatchingPoints& matches) const {
+    return fit(matches).transformation;
+}
 
 /**
- * Algorithm: RANSAC
+ * Algorithm: RANSAC with adaptive termination
  * https://en.wikipedia.org/wiki/Random_sample_consensus
+ * Hartley, Richard; Zisserman, Andrew (2003).
+ * "Multiple View Geometry in Computer Vision", Algorithm 4.5
+ *
+ * Optionally with PROSAC sampling
+ * Chum, Ondrej; Matas, Jiri (2005).
+ * "Matching with PROSAC - Progressive Sample Consensus"
+ *
+ * Or NAPSAC sampling
+ * Nasuto, D.; Craddock, J. M. B. R. (2002).
+ * "NAPSAC: High noise, high dimensional robust estimation - it's in the bag"
+ *
+ * Optionally with early rejection of bad hypotheses (see verifyHypothesis) and local
+ * optimization of the best ones (see optimizeLocally)
  */
-core::Transformation TransformationFitter::execute(const MatchingPoints& matches) const {
+TransformationFitter::FitResult TransformationFitter::fit(const MatchingPoints& matches) const {
+    FitResult fitResult;
+    fitResult.numMatches = matches.fromPts.size();
+    fitResult.maxIters = params.maxIters;
+
     // No point continuing if there are not enough matches to proceed
-    if (matches.fromPts.size() <= core::homography::MIN_BUILD_POINTS) {
-        return core::Transformation{};
+    const uint32_t numMatches = fitResult.numMatches;
+    if (numMatches <= core::homography::MIN_BUILD_POINTS) {
+        return fitResult;
     }
 
     core::Transformation bestTransformation;
-    uint32_t bestNumInliers = core::homography::MIN_BUILD_POINTS + minNonTrivialInliers - 1;
-    
+    uint32_t bestNumInliers = core::homography::MIN_BUILD_POINTS + params.minNonTrivialInliers - 1;
+    uint32_t requiredIters = params.maxIters;
+
+    const SamplingContext samplingContext = buildSamplingContext(matches);
+    const core::homography::InlierCounter::MatchCoordinates matchCoordinates =
+            core::homography::InlierCounter::buildMatchCoordinates(matches.fromPts, matches.toPts);
+    SprtTest sprtTest = buildSprtTest(sprtInitialInlierProb, sprtInitialBadConsistentProb);
+
     // Find the best transformation between the matches by generating transformations
     // for different subsets of the matches and selecting the best one based on how
-    // each transformation performs on the full set of matches.  We parallelize over
-    // individual RANSAC trials.
-    #pragma omp parallel for schedule(dynamic)
-    for (uint32_t iter = 0; iter < maxIters; iter++) {
-        const MatchingPoints minSubsetMatches = getMinSubsetMatches(matches);
+    // each transformation performs on the full set of matches.  Hypotheses are
+    // generated in rounds, after each of which the number of required iterations is
+    // updated from the best inlier ratio found so far.  We parallelize over batches
+    // of RANSAC trials within a round.
+    uint32_t roundStart = 0u;
+    while (roundStart < requiredIters) {
+        const uint32_t roundSize = std::min(std::max(roundStart, (uint32_t)minItersPerRound),
+                (uint32_t)maxItersPerRound);
+        const uint32_t roundEnd = std::min(roundStart + roundSize, requiredIters);
+        const uint32_t prevBestNumInliers = bestNumInliers;
 
-        core::Transformation currTransformation;
-        currTransformation.build(minSubsetMatches.fromPts, minSubsetMatches.toPts);
+        // Each batch keeps its own improving hypotheses, so threads never synchronize.
+        // Hypotheses that cannot beat the best one at the start of the round are
+        // abandoned, which is exact since the improvements are then walked in
+        // iteration order so the selection does not depend on the order threads
+        // finish in.
+        const uint32_t numBatches = (roundEnd - roundStart + params.itersPerBatch - 1)/
+                params.itersPerBatch;
+        std::vector<BatchResult> batchResults(numBatches);
+        #pragma omp parallel for schedule(dynamic)
+        for (uint32_t iBatch = 0; iBatch < numBatches; iBatch++) {
+            const uint32_t batchStart = roundStart + iBatch*params.itersPerBatch;
+            const uint32_t batchEnd = std::min(batchStart + params.itersPerBatch, roundEnd);
+            batchResults[iBatch] = evaluateBatch(matches, matchCoordinates, samplingContext,
+                    sprtTest, prevBestNumInliers, batchStart, batchEnd);
+        }
 
-        const std::vector<cv::Point> mappedFromPts =
-                currTransformation.apply(matches.fromPts); 
+        // Consistency statistics of the rejected hypotheses, integers keep the
+        // reductions independent of the number of threads
+        uint64_t numRejectedInliers = 0u;
+        uint64_t numRejectedVerified = 0u;
+        uint32_t numItersTaken = roundStart;
+        for (const BatchResult& batchResult : batchResults) {
+            numRejectedInliers += batchResult.numRejectedInliers;
+            numRejectedVerified += batchResult.numRejectedVerified;
+            fitResult.numVerifications += batchResult.numVerifications;
 
-        // Transformation building failed if core::Transformation.apply returns no points.
-        if (mappedFromPts.size() == 0) {
-            continue;
+            // Adopt improvements the way a serial fit would, which ends the round as
+            // soon as the number of required iterations drops to the current one
+            for (uint32_t iImprovement = 0; iImprovement < batchResult.numImprovements;
+                    iImprovement++) {
+                if (batchResult.iters[iImprovement] >= requiredIters ||
+                        batchResult.numInliers[iImprovement] <= bestNumInliers) {
+                    continue;
+                }
+
+                bestTransformation = batchResult.transformations[iImprovement];
+                bestNumInliers = batchResult.numInliers[iImprovement];
+                numItersTaken = batchResult.iters[iImprovement] + 1u;
+                if (params.localOptimization) {
+                    optimizeLocally(matches, matchCoordinates, bestTransformation,
+                            bestNumInliers);
+                }
+                requiredIters = std::min(requiredIters, computeSamplerRequiredIters(matches,
+                        samplingContext, sprtTest, bestTransformation, bestNumInliers));
+            }
+        }
+        fitResult.numIters = std::min(roundEnd, std::max(requiredIters, numItersTaken));
+
+        // Update the SPRT from the best inlier ratio and the observed consistency of
+        // the rejected hypotheses
+        if (params.sprt) {
+            const double inlierProb = (bestTransformation.isValid()) ?
+                    (double)bestNumInliers/(double)numMatches : sprtTest.inlierProb;
+            const double badConsistentProb = (numRejectedVerified > 0u) ?
+                    (double)numRejectedInliers/(double)numRejectedVerified :
+                    sprtTest.badConsistentProb;
+            sprtTest = buildSprtTest(inlierProb, badConsistentProb);
+        }
+        roundStart = roundEnd;
+    }
+
+    // Final refit over all inliers, kept only if it does not lose any
+    if (params.localOptimization && bestTransformation.isValid()) {
+        const core::Transformation finalTransformation =
+                fitInliers(matches, bestTransformation, params.epsilon);
+        if (finalTransformation.isValid()) {
+            const uint32_t finalNumInliers = core::homography::InlierCounter::countInliers(
+                    matchCoordinates, finalTransformation.getHomography(), params.epsilon);
+            if (finalNumInliers >= bestNumInliers) {
+                bestTransformation = finalTransformation;
+                bestNumInliers = finalNumInliers;
+            }
         }
+    }
+
+    if (bestTransformation.isValid()) {
+        fitResult.transformation = bestTransformation;
+        fitResult.numInliers = bestNumInliers;
+    }
+
+    return fitResult;
+}
 
-        // Compute number of inliers from all matches, our metric for selecting the
-        // best transformation.
-        const uint32_t numInliers = computeNumSimilarPoints(mappedFromPts, matches.toPts);
-        #pragma omp critical
-        {
-            if (numInliers > bestNumInliers) {
-                bestTransformation = currTransformation;
-                bestNumInliers = numInliers;
+/**
+ * Algorithm: Sequential RANSAC
+ * Vincent, Etienne; Laganiere, Robert (2001).
+ * "Detecting planar homographies in an image pair"
+ */
+std::vector<TransformationFitter::FitResult> TransformationFitter::fitMultiple(
+        const MatchingPoints& matches, uint32_t maxNumInstances) const {
+    std::vector<FitResult> fitResults;
+    MatchingPoints remainingMatches = matches;
+    Params instanceParams = params;
+    for (uint32_t iInstance = 0; iInstance < maxNumInstances; iInstance++) {
+        const FitResult fitResult = TransformationFitter(instanceParams).fit(remainingMatches);
+        if (!fitResult.transformation.isValid()) {
+            break;
+        }
+        fitResults.push_back(fitResult);
+
+        // Keep only the matches that are not explained by the instance, preserving
+        // their order and qualities so the samplers behave the same on the rest
+        const std::vector<bool> inlierMask = computeInlierMask(remainingMatches,
+                fitResult.transformation, params.epsilon);
+        MatchingPoints outlierMatches;
+        for (uint32_t iMatch = 0; iMatch < inlierMask.size(); iMatch++) {
+            if (!inlierMask[iMatch]) {
+                outlierMatches.fromPts.push_back(remainingMatches.fromPts[iMatch]);
+                outlierMatches.toPts.push_back(remainingMatches.toPts[iMatch]);
+                if (!remainingMatches.qualities.empty()) {
+                    outlierMatches.qualities.push_back(remainingMatches.qualities[iMatch]);
+                }
             }
         }
+        remainingMatches = outlierMatches;
+
+        // Later instances are typically smaller and less likely to exist at all
+        instanceParams.maxIters = std::max(instanceParams.maxIters/instanceBudgetDivisor, 1u);
     }
 
-    return bestTransformation;
+    return fitResults;
 }
 
-MatchingPoints TransformationFitter::getMinSubsetMatches(
+TransformationFitter::SamplingContext TransformationFitter::buildSamplingContext(
         const MatchingPoints& matches) const {
-    MatchingPoints minSubsetMatches;
-    for (uint32_t iIndex = 0; iIndex < core::homography::MIN_BUILD_POINTS; iIndex++) {
-        // Select random indices to build the subset, very simple algorithm
-        const uint32_t randomIndex = rand() % matches.fromPts.size();
-        minSubsetMatches.fromPts.push_back(matches.fromPts[randomIndex]);
-        minSubsetMatches.toPts.push_back(matches.toPts[randomIndex]); 
+    SamplingContext samplingContext;
+    samplingContext.numMatches = matches.fromPts.size();
+    if (params.sampler == Sampler::NAPSAC) {
+        buildNapsacGrid(matches, samplingContext);
+    }
+    if (params.sampler != Sampler::PROSAC) {
+        return samplingContext;
+    }
+
+    // Rank the matches by descending quality, matches without a quality score
+    // keep their original order
+    const uint32_t numMatches = samplingContext.numMatches;
+    std::vector<uint32_t>& sortedIndices = samplingContext.sortedIndices;
+    sortedIndices.resize(numMatches);
+    std::iota(sortedIndices.begin(), sortedIndices.end(), 0u);
+    if (!matches.qualities.empty()) {
+        const std::vector<float>& qualities = matches.qualities;
+        std::stable_sort(sortedIndices.begin(), sortedIndices.end(),
+                [&qualities](uint32_t i1, uint32_t i2) {return qualities[i1] > qualities[i2];});
+    }
+
+    // Growth function of the sampling set, chosen such that PROSAC would draw
+    // maxIters subsets from all matches in the same proportions as RANSAC
+    const uint32_t numMinPoints = core::homography::MIN_BUILD_POINTS;
+    double avgNumSubsets = (double)params.maxIters;
+    for (uint32_t iPt = 0; iPt < numMinPoints; iPt++) {
+        avgNumSubsets *= (double)(numMinPoints - iPt)/(double)(numMatches - iPt);
+    }
+    uint32_t numSubsets = 1u;
+    samplingContext.growthSchedule.push_back(numSubsets);
+    for (uint32_t n = numMinPoints; n < numMatches; n++) {
+        const double nextAvgNumSubsets = avgNumSubsets*(double)(n + 1)/(double)(n + 1 - numMinPoints);
+        numSubsets += (uint32_t)std::ceil(nextAvgNumSubsets - avgNumSubsets);
+        samplingContext.growthSchedule.push_back(numSubsets);
+        avgNumSubsets = nextAvgNumSubsets;
+    }
+
+    return samplingContext;
+}
+
+TransformationFitter::MinSubsetMatches TransformationFitter::getMinSubsetMatches(
+        const MatchingPoints& matches, const SamplingContext& samplingContext,
+        uint32_t iter) const {
+    // Each iteration draws from its own random stream, which keeps sampling free
+    // of shared state and makes it independent of the thread it runs on
+    shared::RandomNumberGenerator rng(params.seed, iter);
+
+    // Degenerate or inconsistently oriented subsets cannot produce a sensible
+    // hypothesis, so draw again from the same stream before giving up on the
+    // iteration
+    MinSubsetMatches minSubsetMatches;
+    for (uint32_t iAttempt = 0; iAttempt < maxSubsetAttempts && !minSubsetMatches.isSane;
+            iAttempt++) {
+        uint32_t indices[core::homography::MIN_BUILD_POINTS];
+        if (params.sampler == Sampler::PROSAC) {
+            sampleProsacIndices(samplingContext, rng, iter, indices);
+        } else if (params.sampler == Sampler::NAPSAC) {
+            sampleNapsacIndices(samplingContext, rng, indices);
+        } else {
+            rng.sampleDistinct(samplingContext.numMatches, core::homography::MIN_BUILD_POINTS,
+                    indices);
+        }
+
+        for (uint32_t iPt = 0; iPt < core::homography::MIN_BUILD_POINTS; iPt++) {
+            minSubsetMatches.fromPts[iPt] = matches.fromPts[indices[iPt]];
+            minSubsetMatches.toPts[iPt] = matches.toPts[indices[iPt]];
+        }
+        minSubsetMatches.isSane = core::homography::SanityChecker::areMatchesSane(
+                minSubsetMatches.fromPts, minSubsetMatches.toPts);
     }
 
     return minSubsetMatches;
 }
 
-uint32_t TransformationFitter::computeNumSimilarPoints(
-            const std::vector<cv::Point>& points1,
-            const std::vector<cv::Point>& points2) const {
-    assert(points1.size() == points2.size());
-    const uint32_t numPoints = points1.size();
+void TransformationFitter::sampleProsacIndices(const SamplingContext& samplingContext,
+        shared::RandomNumberGenerator& rng, uint32_t iter, uint32_t* indices) const {
+    const uint32_t numMinPoints = core::homography::MIN_BUILD_POINTS;
+
+    // Find the smallest sampling set whose turn has come at this (1-based) iteration
+    const std::vector<uint32_t>& growthSchedule = samplingContext.growthSchedule;
+    const auto scheduleLoc = std::lower_bound(growthSchedule.cbegin(), growthSchedule.cend(),
+            iter + 1u);
+    if (scheduleLoc == growthSchedule.cend()) {
+        // The sampling set covers every match, PROSAC is now equivalent to RANSAC
+        rng.sampleDistinct(samplingContext.numMatches, numMinPoints, indices);
+    } else {
+        // The newest member of the sampling set is always part of the subset
+        const uint32_t setSize = numMinPoints + std::distance(growthSchedule.cbegin(), scheduleLoc);
+        rng.sampleDistinct(setSize - 1, numMinPoints - 1, indices);
+        indices[numMinPoints - 1] = setSize - 1;
+    }
+
+    // Map ranks back to match indices
+    for (uint32_t iIndex = 0; iIndex < numMinPoints; iIndex++) {
+        indices[iIndex] = samplingContext.sortedIndices[indices[iIndex]];
+    }
+}
+
+void TransformationFitter::buildNapsacGrid(const MatchingPoints& matches,
+        SamplingContext& samplingContext) const {
+    // Bounds of the target points
+    cv::Point minPt = matches.toPts.front();
+    cv::Point maxPt = matches.toPts.front();
+    for (const cv::Point& toPt : matches.toPts) {
+        minPt = {std::min(minPt.x, toPt.x), std::min(minPt.y, toPt.y)};
+        maxPt = {std::max(maxPt.x, toPt.x), std::max(maxPt.y, toPt.y)};
+    }
+
+    // Square cells of side napsacRadius, grown if needed to bound the size of the grid
+    const float maxExtent = (float)std::max(maxPt.x - minPt.x, maxPt.y - minPt.y);
+    const float cellSide = std::max(params.napsacRadius, maxExtent/(float)maxNapsacGridSide);
+    samplingContext.gridSize = {(int32_t)((float)(maxPt.x - minPt.x)/cellSide) + 1,
+            (int32_t)((float)(maxPt.y - minPt.y)/cellSide) + 1};
+
+    // Counting sort of the matches by cell
+    const uint32_t numMatches = samplingContext.numMatches;
+    const uint32_t numCells = samplingContext.gridSize.area();
+    samplingContext.cellOfMatch.resize(numMatches);
+    samplingContext.cellStarts.assign(numCells + 1, 0u);
+    for (uint32_t iMatch = 0; iMatch < numMatches; iMatch++) {
+        const cv::Point offset = matches.toPts[iMatch] - minPt;
+        const uint32_t col = (uint32_t)((float)offset.x/cellSide);
+        const uint32_t row = (uint32_t)((float)offset.y/cellSide);
+        const uint32_t cell = row*samplingContext.gridSize.width + col;
+        samplingContext.cellOfMatch[iMatch] = cell;
+        samplingContext.cellStarts[cell + 1]++;
+    }
+    std::partial_sum(samplingContext.cellStarts.cbegin(), samplingContext.cellStarts.cend(),
+            samplingContext.cellStarts.begin());
+
+    std::vector<uint32_t> cellFill(samplingContext.cellStarts.cbegin(),
+            samplingContext.cellStarts.cend() - 1);
+    samplingContext.cellMatchIndices.resize(numMatches);
+    for (uint32_t iMatch = 0; iMatch < numMatches; iMatch++) {
+        const uint32_t cell = samplingContext.cellOfMatch[iMatch];
+        samplingContext.cellMatchIndices[cellFill[cell]++] = iMatch;
+    }
+}
+
+void TransformationFitter::sampleNapsacIndices(const SamplingContext& samplingContext,
+        shared::RandomNumberGenerator& rng, uint32_t* indices) const {
+    static constexpr uint32_t numRest = core::homography::MIN_BUILD_POINTS - 1;
+    indices[0] = rng.uniform(samplingContext.numMatches);
+
+    uint32_t numNeighbors = 0u;
+    forEachNapsacNeighbor(samplingContext, indices[0],
+            [&numNeighbors](uint32_t) {numNeighbors++;});
+    if (numNeighbors < numRest) {
+        rng.sampleDistinct(samplingContext.numMatches, core::homography::MIN_BUILD_POINTS,
+                indices);
+        return;
+    }
+
+    // Draw distinct ranks within the neighborhood, then map them to match indices
+    // in a single pass over the neighborhood
+    uint32_t ranks[numRest];
+    rng.sampleDistinct(numNeighbors, numRest, ranks);
+    uint32_t rank = 0u;
+    forEachNapsacNeighbor(samplingContext, indices[0],
+            [&ranks, &rank, indices](uint32_t neighborIndex) {
+                for (uint32_t iRest = 0; iRest < numRest; iRest++) {
+                    if (ranks[iRest] == rank) {
+                        indices[iRest + 1] = neighborIndex;
+                    }
+                }
+                rank++;
+            });
+}
+
+template<typename NeighborFunction>
+void TransformationFitter::forEachNapsacNeighbor(const SamplingContext& samplingContext,
+        uint32_t centerIndex, NeighborFunction neighborFunction) const {
+    const cv::Size& gridSize = samplingContext.gridSize;
+    const int32_t centerCell = samplingContext.cellOfMatch[centerIndex];
+    const int32_t centerCol = centerCell % gridSize.width;
+    const int32_t centerRow = centerCell / gridSize.width;
+
+    for (int32_t row = std::max(centerRow - 1, 0);
+            row <= std::min(centerRow + 1, gridSize.height - 1); row++) {
+        for (int32_t col = std::max(centerCol - 1, 0);
+                col <= std::min(centerCol + 1, gridSize.width - 1); col++) {
+            const uint32_t cell = row*gridSize.width + col;
+            for (uint32_t iCell = samplingContext.cellStarts[cell];
+                    iCell < samplingContext.cellStarts[cell + 1]; iCell++) {
+                const uint32_t neighborIndex = samplingContext.cellMatchIndices[iCell];
+                if (neighborIndex != centerIndex) {
+                    neighborFunction(neighborIndex);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Hypotheses are all generated before any is verified, then the matches are
+ * verified a chunk at a time against every hypothesis still in the running, so the
+ * coordinates of a chunk are loaded once per batch rather than once per hypothesis.
+ * Each hypothesis still gets the same block by block decisions as if it were
+ * verified on its own, see verifyHypothesis.
+ */
+TransformationFitter::BatchResult TransformationFitter::evaluateBatch(
+        const MatchingPoints& matches,
+        const core::homography::InlierCounter::MatchCoordinates& matchCoordinates,
+        const SamplingContext& samplingContext, const SprtTest& sprtTest,
+        uint32_t maxRejectedInliers, uint32_t batchStart, uint32_t batchEnd) const {
+    // Generate the hypotheses of the batch
+    std::array<core::Transformation, MAX_ITERS_PER_BATCH> transformations;
+    std::array<uint32_t, MAX_ITERS_PER_BATCH> iters;
+    uint32_t numHypotheses = 0u;
+    for (uint32_t iter = batchStart; iter < batchEnd; iter++) {
+        const MinSubsetMatches minSubsetMatches =
+                getMinSubsetMatches(matches, samplingContext, iter);
+        if (!minSubsetMatches.isSane) {
+            continue;
+        }
+
+        transformations[numHypotheses].build(minSubsetMatches.fromPts, minSubsetMatches.toPts);
+        if (transformations[numHypotheses].isValid()) {
+            iters[numHypotheses] = iter;
+            numHypotheses++;
+        }
+    }
 
-    uint32_t numSimilarPoints = 0u;
-    for (uint32_t iPt = 0; iPt < numPoints; iPt++) {
-        // Use L2 distance as our metric
-        const float distance = cv::norm(points1[iPt] - points2[iPt]);
-        if (distance < epsilon) {
-            numSimilarPoints++;
+    // Verify chunks of matches against every hypothesis still in the running
+    std::array<Verification, MAX_ITERS_PER_BATCH> verifications;
+    const uint32_t numBlocks = core::homography::InlierCounter::getNumBlocks(matchCoordinates);
+    for (uint32_t chunkStart = 0; chunkStart < numBlocks;
+            chunkStart += blocksPerVerificationChunk) {
+        const uint32_t chunkEnd = std::min(chunkStart + blocksPerVerificationChunk, numBlocks);
+        for (uint32_t iHypothesis = 0; iHypothesis < numHypotheses; iHypothesis++) {
+            if (!verifications[iHypothesis].isRejected) {
+                verifyHypothesis(matchCoordinates,
+                        transformations[iHypothesis].getHomography(), sprtTest,
+                        maxRejectedInliers, chunkEnd, verifications[iHypothesis]);
+            }
         }
     }
 
-    return numSimilarPoints;
+    // Hypotheses are in increasing iteration order, so only keeping strict
+    // improvements breaks ties by the iteration index
+    BatchResult batchResult;
+    for (uint32_t iHypothesis = 0; iHypothesis < numHypotheses; iHypothesis++) {
+        const Verification& verification = verifications[iHypothesis];
+        batchResult.numVerifications += verification.numVerified;
+        if (verification.isRejected) {
+            batchResult.numRejectedInliers += verification.numInliers;
+            batchResult.numRejectedVerified += verification.numVerified;
+            continue;
+        }
+
+        const uint32_t iImprovement = batchResult.numImprovements;
+        if (iImprovement == 0u ||
+                verification.numInliers > batchResult.numInliers[iImprovement - 1]) {
+            batchResult.transformations[iImprovement] = transformations[iHypothesis];
+            batchResult.numInliers[iImprovement] = verification.numInliers;
+            batchResult.iters[iImprovement] = iters[iHypothesis];
+            batchResult.numImprovements++;
+        }
+    }
+
+    return batchResult;
+}
+
+/**
+ * Algorithm: Randomized RANSAC with the sequential probability ratio test
+ * Chum, Ondrej; Matas, Jiri (2008).
+ * "Optimal Randomized RANSAC"
+ */
+void TransformationFitter::verifyHypothesis(
+        const core::homography::InlierCounter::MatchCoordinates& matchCoordinates,
+        const core::homography::Homography& homography, const SprtTest& sprtTest,
+        uint32_t maxRejectedInliers, uint32_t endBlock, Verification& verification) const {
+    using core::homography::InlierCounter;
+    const uint32_t numMatches = matchCoordinates.numPoints;
+    const float sqrEpsilon = params.epsilon*params.epsilon;
+
+    // Matches are verified a block at a time, so is the decision to reject
+    for (uint32_t iBlock = verification.numVerified/InlierCounter::BLOCK_SIZE;
+            iBlock < endBlock; iBlock++) {
+        const uint32_t blockMask = InlierCounter::checkBlock(matchCoordinates, iBlock,
+                homography, sqrEpsilon);
+        const uint32_t numBlockMatches = std::min(numMatches - verification.numVerified,
+                (uint32_t)InlierCounter::BLOCK_SIZE);
+        const uint32_t numBlockInliers = __builtin_popcount(blockMask);
+        verification.numVerified += numBlockMatches;
+        verification.numInliers += numBlockInliers;
+        verification.logLikelihoodRatio += numBlockInliers*sprtTest.consistentLogRatio +
+                (numBlockMatches - numBlockInliers)*sprtTest.inconsistentLogRatio;
+
+        const uint32_t numRemaining = numMatches - verification.numVerified;
+        if (verification.numInliers + numRemaining <= maxRejectedInliers ||
+                verification.logLikelihoodRatio > sprtTest.logDecisionThreshold) {
+            verification.isRejected = true;
+            break;
+        }
+    }
+}
+
+TransformationFitter::SprtTest TransformationFitter::buildSprtTest(double inlierProb,
+        double badConsistentProb) const {
+    SprtTest sprtTest;
+    sprtTest.inlierProb = inlierProb;
+    sprtTest.badConsistentProb = std::max(badConsistentProb, sprtMinBadConsistentProb);
+    sprtTest.logDecisionThreshold = std::numeric_limits<double>::infinity();
+    if (!params.sprt || sprtTest.inlierProb >= 1.0 ||
+            sprtTest.badConsistentProb >= sprtTest.inlierProb) {
+        return sprtTest;
+    }
+
+    const double epsilon = sprtTest.inlierProb;
+    const double delta = sprtTest.badConsistentProb;
+    sprtTest.consistentLogRatio = std::log(delta/epsilon);
+    sprtTest.inconsistentLogRatio = std::log((1.0 - delta)/(1.0 - epsilon));
+
+    // The optimal threshold A solves A = K + log(A), where K accounts for the cost
+    // of generating hypotheses and the average information gained per match
+    const double matchInformation = (1.0 - delta)*std::log((1.0 - delta)/(1.0 - epsilon)) +
+            delta*std::log(delta/epsilon);
+    const double baseThreshold = sprtHypothesisCost*matchInformation + 1.0;
+    double decisionThreshold = baseThreshold;
+    for (uint32_t iIter = 0; iIter < sprtNumThresholdIters; iIter++) {
+        decisionThreshold = baseThreshold + std::log(decisionThreshold);
+    }
+    sprtTest.logDecisionThreshold = std::log(decisionThreshold);
+
+    return sprtTest;
+}
+
+/**
+ * Algorithm: Locally optimized RANSAC with iterated least squares
+ * Lebeda, Karel; Matas, Jiri; Chum, Ondrej (2012).
+ * "Fixing the Locally Optimized RANSAC"
+ */
+bool TransformationFitter::optimizeLocally(const MatchingPoints& matches,
+        const core::homography::InlierCounter::MatchCoordinates& matchCoordinates,
+        core::Transformation& transformation, uint32_t& numInliers) const {
+    bool isImproved = false;
+    core::Transformation currTransformation = transformation;
+    for (uint32_t iIter = 0; iIter < numLocalOptimizationIters; iIter++) {
+        const float threshMultiplier = localOptimizationThreshMultiplier -
+                (localOptimizationThreshMultiplier - 1.0f)*(float)iIter/
+                (float)(numLocalOptimizationIters - 1u);
+        currTransformation = fitInliers(matches, currTransformation,
+                threshMultiplier*params.epsilon);
+        if (!currTransformation.isValid()) {
+            break;
+        }
+
+        const uint32_t currNumInliers = core::homography::InlierCounter::countInliers(
+                matchCoordinates, currTransformation.getHomography(), params.epsilon);
+        if (currNumInliers > numInliers) {
+            transformation = currTransformation;
+            numInliers = currNumInliers;
+            isImproved = true;
+        }
+    }
+
+    return isImproved;
+}
+
+core::Transformation TransformationFitter::fitInliers(const MatchingPoints& matches,
+        const core::Transformation& transformation, float epsilon) const {
+    const std::vector<bool> inlierMask = computeInlierMask(matches, transformation, epsilon);
+
+    std::vector<cv::Point> inlierFromPts;
+    std::vector<cv::Point> inlierToPts;
+    for (uint32_t iPt = 0; iPt < inlierMask.size(); iPt++) {
+        if (inlierMask[iPt]) {
+            inlierFromPts.push_back(matches.fromPts[iPt]);
+            inlierToPts.push_back(matches.toPts[iPt]);
+        }
+    }
+
+    core::Transformation inlierTransformation;
+    if (inlierFromPts.size() >= core::homography::MIN_BUILD_POINTS) {
+        inlierTransformation.buildLeastSquares(inlierFromPts, inlierToPts);
+    }
+
+    return inlierTransformation;
+}
+
+std::vector<bool> TransformationFitter::computeInlierMask(const MatchingPoints& matches,
+        const core::Transformation& transformation, float epsilon) const {
+    using core::homography::InlierCounter;
+    const InlierCounter::MatchCoordinates matchCoordinates =
+            InlierCounter::buildMatchCoordinates(matches.fromPts, matches.toPts);
+    std::vector<uint8_t> blockMasks;
+    InlierCounter::countInliers(matchCoordinates, transformation.getHomography(),
+            epsilon, &blockMasks);
+
+    std::vector<bool> inlierMask(matchCoordinates.numPoints, false);
+    for (uint32_t iPt = 0; iPt < matchCoordinates.numPoints; iPt++) {
+        inlierMask[iPt] = ((blockMasks[iPt/InlierCounter::BLOCK_SIZE] >>
+                (iPt % InlierCounter::BLOCK_SIZE)) & 1u) != 0u;
+    }
+
+    return inlierMask;
 }
 
+uint32_t TransformationFitter::computeSamplerRequiredIters(const MatchingPoints& matches,
+        const SamplingContext& samplingContext, const SprtTest& sprtTest,
+        const core::Transformation& transformation, uint32_t numInliers) const {
+    uint32_t requiredIters = params.maxIters;
+    switch (params.sampler) {
+    case Sampler::PROSAC:
+        requiredIters = computeProsacRequiredIters(matches, samplingContext, transformation);
+        break;
+    case Sampler::NAPSAC:
+        requiredIters = computeNapsacRequiredIters(matches, samplingContext, transformation);
+        break;
+    default:
+        requiredIters = computeRequiredIters(numInliers, samplingContext.numMatches);
+        break;
+    }
+
+    // The SPRT wrongly rejects a good hypothesis with probability at most 1/A, which
+    // to first order requires proportionally more iterations
+    const double sprtRejectionProb = std::exp(-sprtTest.logDecisionThreshold);
+    return (uint32_t)std::min((double)requiredIters/(1.0 - sprtRejectionProb),
+            (double)params.maxIters);
+}
+
+uint32_t TransformationFitter::computeRequiredIters(uint32_t numInliers,
+        uint32_t numMatches) const {
+    // Probability that a single uniform minimal subset contains only inliers
+    const double inlierRatio = (double)numInliers/(double)numMatches;
+    const double subsetSuccessProb = std::pow(inlierRatio,
+            (double)core::homography::MIN_BUILD_POINTS);
+
+    return computeRequiredIters(subsetSuccessProb);
+}
+
+uint32_t TransformationFitter::computeRequiredIters(double subsetSuccessProb) const {
+    // Full confidence disables early termination, even for outlier-free matches
+    if (params.confidence >= 1.0f) {
+        return params.maxIters;
+    }
+    if (subsetSuccessProb >= 1.0) {
+        return 0u;
+    }
+    if (subsetSuccessProb <= 0.0) {
+        return params.maxIters;
+    }
+
+    // Solve 1 - confidence = (1 - subsetSuccessProb)^k for k
+    const double requiredIters = std::log(1.0 - (double)params.confidence)/
+            std::log1p(-subsetSuccessProb);
+    if (!(requiredIters < (double)params.maxIters)) {
+        return params.maxIters;
+    }
+
+    return (uint32_t)std::ceil(requiredIters);
+}
+
+/**
+ * Algorithm: PROSAC termination criterion (maximality and non-randomness)
+ * Chum, Ondrej; Matas, Jiri (2005).
+ * "Matching with PROSAC - Progressive Sample Consensus"
+ */
+uint32_t TransformationFitter::computeProsacRequiredIters(const MatchingPoints& matches,
+        const SamplingContext& samplingContext,
+        const core::Transformation& transformation) const {
+    const std::vector<bool> inlierMask = computeInlierMask(matches, transformation,
+            params.epsilon);
+
+    // Consider every set of top quality matches as the set the fit will be judged on
+    const uint32_t numMinPoints = core::homography::MIN_BUILD_POINTS;
+    uint32_t requiredIters = params.maxIters;
+    uint32_t numTopInliers = 0u;
+    for (uint32_t setSize = 1; setSize <= samplingContext.numMatches; setSize++) {
+        if (inlierMask[samplingContext.sortedIndices[setSize - 1]]) {
+            numTopInliers++;
+        }
+        if (setSize <= numMinPoints) {
+            continue;
+        }
+
+        // Non-randomness: the inliers must be unlikely to support an incorrect model
+        // by chance, using a normal approximation of the binomial distribution
+        const double numFreeMatches = (double)(setSize - numMinPoints);
+        const double minNumInliers = (double)numMinPoints + numFreeMatches*prosacBeta +
+                prosacNonRandomQuantile*std::sqrt(numFreeMatches*prosacBeta*(1.0 - prosacBeta));
+        if ((double)numTopInliers < minNumInliers) {
+            continue;
+        }
+
+        // Maximality: enough subsets must have been drawn from this set
+        requiredIters = std::min(requiredIters, computeRequiredIters(numTopInliers, setSize));
+    }
+
+    return requiredIters;
+}
+
+uint32_t TransformationFitter::computeNapsacRequiredIters(const MatchingPoints& matches,
+        const SamplingContext& samplingContext,
+        const core::Transformation& transformation) const {
+    const std::vector<bool> inlierMask = computeInlierMask(matches, transformation,
+            params.epsilon);
+    const uint32_t numMatches = samplingContext.numMatches;
+    const uint32_t numInliers = std::count(inlierMask.cbegin(), inlierMask.cend(), true);
+    const uint32_t numRest = core::homography::MIN_BUILD_POINTS - 1;
+
+    // A subset is outlier-free if its first match is an inlier and the rest, drawn
+    // without replacement from the neighborhood, are too.  Average over all matches.
+    double subsetSuccessProb = 0.0;
+    for (uint32_t iMatch = 0; iMatch < numMatches; iMatch++) {
+        if (!inlierMask[iMatch]) {
+            continue;
+        }
+
+        uint32_t numNeighbors = 0u;
+        uint32_t numInlierNeighbors = 0u;
+        forEachNapsacNeighbor(samplingContext, iMatch,
+                [&inlierMask, &numNeighbors, &numInlierNeighbors](uint32_t neighborIndex) {
+                    numNeighbors++;
+                    numInlierNeighbors += inlierMask[neighborIndex] ? 1u : 0u;
+                });
+
+        double restSuccessProb = 1.0;
+        if (numNeighbors < numRest) {
+            // Sparse neighborhoods fall back to uniform subsets
+            restSuccessProb = std::pow((double)numInliers/(double)numMatches, (double)numRest);
+        } else {
+            for (uint32_t iRest = 0; iRest < numRest; iRest++) {
+                restSuccessProb *= std::max((double)numInlierNeighbors - (double)iRest, 0.0)/
+                        (double)(numNeighbors - iRest);
+            }
+        }
+        subsetSuccessProb += restSuccessProb;
+    }
+    subsetSuccessProb /= (double)numMatches;
+
+    return computeRequiredIters(subsetSuccessProb);
+}
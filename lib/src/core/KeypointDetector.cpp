@@ -24,7 +24,10 @@ const std::vector<cv::Point> KeypointDetector::circlePoints =
 std::vector<cv::Point> KeypointDetector::execute(const cv::Mat& image) const {
     validateImage(image);
 
-    std::vector<cv::Point> cornerPoints;
+    // Each row keeps its own keypoints, concatenated in row order afterwards so that
+    // the keypoints are in the same order regardless of the number of threads
+    const int32_t numRows = std::max(image.rows - 2*radius, 0);
+    std::vector<std::vector<cv::Point>> rowCornerPoints(numRows);
     // Check each row for keypoints in parallel
     #pragma omp parallel for schedule(static)
     for (int32_t iRow = radius; iRow < image.rows - radius; iRow++) {
@@ -39,15 +42,17 @@ std::vector<cv::Point> KeypointDetector::execute(const cv::Mat& image) const {
                 const bool circleIsStrong = isCandidateStrong(
                         image, currPoint, circlePoints, circleThresh);
                 if (circleIsStrong) {
-                    #pragma omp critical
-                    {
-                        cornerPoints.push_back(currPoint);
-                    }
+                    rowCornerPoints[iRow - radius].push_back(currPoint);
                 }
             }
         }
     }
 
+    std::vector<cv::Point> cornerPoints;
+    for (const std::vector<cv::Point>& rowPoints : rowCornerPoints) {
+        cornerPoints.insert(cornerPoints.end(), rowPoints.begin(), rowPoints.end());
+    }
+
     return cornerPoints;
 }
 
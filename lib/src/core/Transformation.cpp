@@ -1,5 +1,6 @@
 #include "core/Transformation.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 #include "opencv2/imgproc.hpp"
@@ -20,6 +21,14 @@ void Transformation::build(const std::vector<cv::Point>& fromPts,
     shared::VALIDATE_ARGUMENT(toPts.size() == homography::MIN_BUILD_POINTS,
             "core::Transformation::build takes in 4 points per param");
 
+    homography::MinPointSet fromPtSet, toPtSet;
+    std::copy(fromPts.cbegin(), fromPts.cend(), fromPtSet.begin());
+    std::copy(toPts.cbegin(), toPts.cend(), toPtSet.begin());
+    build(fromPtSet, toPtSet);
+}
+
+void Transformation::build(const homography::MinPointSet& fromPts,
+        const homography::MinPointSet& toPts) {
     isTransformationValid = false;
 
     // First, check sanity of the matches
@@ -29,49 +38,135 @@ void Transformation::build(const std::vector<cv::Point>& fromPts,
     }
 
     // Build the homography only if the sanity checks pass
-    const cv::Mat homography = homography::Builder::build(fromPts, toPts);
+    isTransformationValid = homography::Builder::build(fromPts, toPts, transformation);
+}
+
+void Transformation::buildLeastSquares(const std::vector<cv::Point>& fromPts,
+        const std::vector<cv::Point>& toPts) {
+    shared::VALIDATE_ARGUMENT(fromPts.size() >= homography::MIN_BUILD_POINTS,
+            "core::Transformation::buildLeastSquares takes in at least 4 points per param");
+    shared::VALIDATE_ARGUMENT(toPts.size() == fromPts.size(),
+            "core::Transformation::buildLeastSquares takes in equal numbers of points");
 
-    transformation = homography;
-    isTransformationValid = true;
+    isTransformationValid = homography::Builder::buildLeastSquares(fromPts, toPts,
+            transformation);
 }
 
 bool Transformation::isValid() const {
     return isTransformationValid;
 }
 
+const homography::Homography& Transformation::getHomography() const {
+    return transformation;
+}
+
 std::vector<cv::Point> Transformation::apply(const std::vector<cv::Point>& inputPts) const {
+    std::vector<cv::Point> outputPoints;
+    apply(inputPts, outputPoints);
+
+    return outputPoints;
+}
+
+void Transformation::apply(const std::vector<cv::Point>& inputPts,
+        std::vector<cv::Point>& outputPts) const {
     if (!isTransformationValid) {
-        return std::vector<cv::Point>{};
+        outputPts.clear();
+        return;
     }
 
-    const std::vector<cv::Point> outputPoints =
-            homography::Evaluator::applyPoints(inputPts, transformation);
+    homography::Evaluator::applyPoints(inputPts, transformation, outputPts);
+}
 
-    return outputPoints;
+std::vector<cv::Point2f> Transformation::projectCorners(const cv::Size& imageSize) const {
+    return homography::Evaluator::projectCorners(imageSize, {transformation});
 }
 
-cv::Mat Transformation::augment(const cv::Mat& targetImage,
-        const cv::Mat& replacementImage) const {
+bool Transformation::isAugmentationSane(const cv::Size& targetSize,
+        const cv::Size& replacementSize) const {
     if (!isTransformationValid) {
-        return targetImage.clone();
+        return false;
     }
 
     // Check sanity of the proposed augmentation by first transforming the image corners
-    const std::vector<cv::Point> replacementCorners{{0, 0}, {replacementImage.cols-1, 0},
-            {replacementImage.cols-1, replacementImage.rows-1}, {0, replacementImage.rows-1}};
-    const cv::Rect targetRegion(0, 0, targetImage.cols, targetImage.rows);
-    const bool augmentationIsSane = homography::Evaluator::isAugmentationSane(
-            replacementCorners, targetRegion, transformation);
-    if (!augmentationIsSane) {
-        return targetImage.clone();
+    const homography::MinPointSet replacementCorners{{{0, 0}, {replacementSize.width-1, 0},
+            {replacementSize.width-1, replacementSize.height-1}, {0, replacementSize.height-1}}};
+    const cv::Rect targetRegion(0, 0, targetSize.width, targetSize.height);
+    return homography::Evaluator::isAugmentationSane(replacementCorners, targetRegion,
+            transformation);
+}
+
+cv::Mat Transformation::augment(const cv::Mat& targetImage,
+        const cv::Mat& replacementImage) const {
+    return augment(targetImage, replacementImage, std::vector<Transformation>{*this});
+}
+
+cv::Mat Transformation::augment(const cv::Mat& targetImage, const cv::Mat& replacementImage,
+        const std::vector<Transformation>& transformations) {
+    return augment(targetImage, std::vector<cv::Mat>{replacementImage}, transformations);
+}
+
+cv::Mat Transformation::augment(const cv::Mat& targetImage,
+        const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Transformation>& transformations) {
+    cv::Mat augmentedImage = targetImage.clone();
+    augmentInPlace(augmentedImage, replacementPyramid, transformations);
+
+    return augmentedImage;
+}
+
+bool Transformation::augmentInPlace(cv::Mat& image,
+        const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Transformation>& transformations,
+        homography::Evaluator::WarpCache* warpCache) {
+    shared::VALIDATE_ARGUMENT(!replacementPyramid.empty(),
+            "core::Transformation::augment takes in at least one replacement image");
+
+    const std::vector<homography::Homography> saneHomographies = selectSaneHomographies(
+            image.size(), replacementPyramid.front().size(), transformations);
+    if (saneHomographies.empty()) {
+        return false;
     }
 
     // We can proceed with the augmentation
-    const cv::Mat augmentedImage = homography::Evaluator::augment(
-            targetImage, replacementImage, transformation);
+    homography::Evaluator::augmentInPlace(image, replacementPyramid, saneHomographies,
+            warpCache);
 
-    return augmentedImage;
+    return true;
 }
 
+bool Transformation::warp(const cv::Size& imageSize,
+        const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Transformation>& transformations,
+        homography::Evaluator::WarpCache& warpCache) {
+    shared::VALIDATE_ARGUMENT(!replacementPyramid.empty(),
+            "core::Transformation::warp takes in at least one replacement image");
+
+    const std::vector<homography::Homography> saneHomographies = selectSaneHomographies(
+            imageSize, replacementPyramid.front().size(), transformations);
+    if (saneHomographies.empty()) {
+        return false;
+    }
+
+    homography::Evaluator::warp(imageSize, replacementPyramid, saneHomographies, warpCache);
+
+    return true;
+}
+
+std::vector<cv::Mat> Transformation::buildReplacementPyramid(const cv::Mat& replacementImage) {
+    return homography::Evaluator::buildPyramid(replacementImage);
 }
 
+std::vector<homography::Homography> Transformation::selectSaneHomographies(
+        const cv::Size& imageSize, const cv::Size& replacementSize,
+        const std::vector<Transformation>& transformations) {
+    std::vector<homography::Homography> saneHomographies;
+    for (const Transformation& transformation : transformations) {
+        if (transformation.isAugmentationSane(imageSize, replacementSize)) {
+            saneHomographies.push_back(transformation.transformation);
+        }
+    }
+
+    return saneHomographies;
+}
+
+}
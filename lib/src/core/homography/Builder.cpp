@@ -1,56 +1,196 @@
 #include "core/homography/Builder.hpp"
 
 #include <cmath>
-
-#include "opencv2/imgproc.hpp"
+#include <utility>
 
 namespace core {
 namespace homography {
 
-cv::Mat Builder::build(const std::vector<cv::Point>& fromPts,
-        const std::vector<cv::Point>& toPts) {
-    // Obtain the system of equations that defines the homography
-    const cv::Mat A = buildA(fromPts, toPts);
+/**
+ * Algorithm: Normalized direct linear transform with the last homography element
+ * fixed to 1, solved as an 8x8 linear system
+ * Hartley, Richard; Zisserman, Andrew (2003).
+ * "Multiple View Geometry in Computer Vision", Algorithm 4.2
+ */
+bool Builder::build(const MinPointSet& fromPts, const MinPointSet& toPts,
+        Homography& homography) {
+    cv::Matx33d fromNormalization, toNormalization;
+    if (!computeNormalization(fromPts.data(), MIN_BUILD_POINTS, fromNormalization) ||
+            !computeNormalization(toPts.data(), MIN_BUILD_POINTS, toNormalization)) {
+        return false;
+    }
 
-    // One way to estimate the homography is to simply compute the eigenvector
-    // associated with the smallest eigenvalue of the A matrix
-    const cv::Mat AtA = A.t()*A;
-    cv::Mat eigenvals, eigenvecs;
-    cv::eigen(AtA, eigenvals, eigenvecs);
-    const cv::Mat selectedEigenvec = eigenvecs.row(eigenvecs.rows - 1).clone();
+    // Obtain the system of equations that defines the homography between the
+    // normalized points, two equations per match
+    double A[numUnknowns][numUnknowns];
+    double b[numUnknowns];
+    for (uint32_t iMatch = 0; iMatch < MIN_BUILD_POINTS; iMatch++) {
+        cv::Point2d rhs;
+        fillEquations(normalize(fromNormalization, fromPts[iMatch]),
+                normalize(toNormalization, toPts[iMatch]), A[2*iMatch], A[2*iMatch + 1], rhs);
+        b[2*iMatch] = rhs.x;
+        b[2*iMatch + 1] = rhs.y;
+    }
 
-    // Reshape to transformation matrix
-    const cv::Mat homography = selectedEigenvec.reshape(0, TRANSFORM_MAT_SIDE);
-    return homography;
+    if (!solveInPlace(A, b)) {
+        return false;
+    }
+
+    homography = denormalize(b, fromNormalization, toNormalization);
+    return true;
 }
 
-cv::Mat Builder::buildA(const std::vector<cv::Point>& fromPts,
-        const std::vector<cv::Point>& toPts) {
-    cv::Mat A = cv::Mat::zeros(numRowsA, numColsA, CV_32F);
-    for (uint32_t iMatch = 0; iMatch < MIN_BUILD_POINTS; iMatch++) {
-        const float x = (float)fromPts[iMatch].x;
-        const float y = (float)fromPts[iMatch].y;
-        const float xp = (float)toPts[iMatch].x;
-        const float yp = (float)toPts[iMatch].y;
+/**
+ * Algorithm: Same as above, solving the normal equations of the overdetermined
+ * system
+ */
+bool Builder::buildLeastSquares(const std::vector<cv::Point>& fromPts,
+        const std::vector<cv::Point>& toPts, Homography& homography) {
+    assert(fromPts.size() == toPts.size());
+    const uint32_t numPoints = fromPts.size();
+    if (numPoints < MIN_BUILD_POINTS) {
+        return false;
+    }
+
+    cv::Matx33d fromNormalization, toNormalization;
+    if (!computeNormalization(fromPts.data(), numPoints, fromNormalization) ||
+            !computeNormalization(toPts.data(), numPoints, toNormalization)) {
+        return false;
+    }
+
+    // Accumulate A^T A and A^T b one match at a time
+    double AtA[numUnknowns][numUnknowns] = {};
+    double Atb[numUnknowns] = {};
+    for (uint32_t iMatch = 0; iMatch < numPoints; iMatch++) {
+        double rowX[numUnknowns];
+        double rowY[numUnknowns];
+        cv::Point2d rhs;
+        fillEquations(normalize(fromNormalization, fromPts[iMatch]),
+                normalize(toNormalization, toPts[iMatch]), rowX, rowY, rhs);
 
-        A.at<float>(2*iMatch, 3) = -x;
-        A.at<float>(2*iMatch, 4) = -y;
-        A.at<float>(2*iMatch, 5) = -1.0f;
-        A.at<float>(2*iMatch, 6) = x*yp;
-        A.at<float>(2*iMatch, 7) = y*yp;
-        A.at<float>(2*iMatch, 8) = yp;
+        for (uint32_t iRow = 0; iRow < numUnknowns; iRow++) {
+            for (uint32_t iCol = 0; iCol < numUnknowns; iCol++) {
+                AtA[iRow][iCol] += rowX[iRow]*rowX[iCol] + rowY[iRow]*rowY[iCol];
+            }
+            Atb[iRow] += rowX[iRow]*rhs.x + rowY[iRow]*rhs.y;
+        }
+    }
 
-        A.at<float>(2*iMatch + 1, 0) = x;
-        A.at<float>(2*iMatch + 1, 1) = y;
-        A.at<float>(2*iMatch + 1, 2) = 1.0f;
-        A.at<float>(2*iMatch + 1, 6) = -x*xp;
-        A.at<float>(2*iMatch + 1, 7) = -y*xp;
-        A.at<float>(2*iMatch + 1, 8) = -xp;
+    if (!solveInPlace(AtA, Atb)) {
+        return false;
     }
 
-    return A;
+    homography = denormalize(Atb, fromNormalization, toNormalization);
+    return true;
 }
 
+void Builder::fillEquations(const cv::Point2d& fromPt, const cv::Point2d& toPt,
+        double (&rowX)[numUnknowns], double (&rowY)[numUnknowns], cv::Point2d& rhs) {
+    // With h22 = 1:
+    //   x' (h20 x + h21 y + 1) = h00 x + h01 y + h02
+    //   y' (h20 x + h21 y + 1) = h10 x + h11 y + h12
+    const double x = fromPt.x;
+    const double y = fromPt.y;
+    const double xp = toPt.x;
+    const double yp = toPt.y;
+
+    rowX[0] = x; rowX[1] = y; rowX[2] = 1.0;
+    rowX[3] = 0.0; rowX[4] = 0.0; rowX[5] = 0.0;
+    rowX[6] = -x*xp; rowX[7] = -y*xp;
+
+    rowY[0] = 0.0; rowY[1] = 0.0; rowY[2] = 0.0;
+    rowY[3] = x; rowY[4] = y; rowY[5] = 1.0;
+    rowY[6] = -x*yp; rowY[7] = -y*yp;
+
+    rhs = {xp, yp};
 }
+
+Homography Builder::denormalize(const double (&solution)[numUnknowns],
+        const cv::Matx33d& fromNormalization, const cv::Matx33d& toNormalization) {
+    // The inverse of a similarity transform is known in closed form
+    const cv::Matx33d normalizedHomography(solution[0], solution[1], solution[2],
+            solution[3], solution[4], solution[5], solution[6], solution[7], 1.0);
+    const double toScale = toNormalization(0, 0);
+    const cv::Matx33d toDenormalization(
+            1.0/toScale, 0.0, -toNormalization(0, 2)/toScale,
+            0.0, 1.0/toScale, -toNormalization(1, 2)/toScale,
+            0.0, 0.0, 1.0);
+    const cv::Matx33d fullHomography = toDenormalization*normalizedHomography*fromNormalization;
+
+    // Homographies are defined up to scale, use the unit norm representative
+    return fullHomography*(1.0/cv::norm(fullHomography));
 }
 
+bool Builder::computeNormalization(const cv::Point* points, uint32_t numPoints,
+        cv::Matx33d& normalization) {
+    cv::Point2d centroid;
+    for (uint32_t iPt = 0; iPt < numPoints; iPt++) {
+        centroid.x += points[iPt].x;
+        centroid.y += points[iPt].y;
+    }
+    centroid.x /= (double)numPoints;
+    centroid.y /= (double)numPoints;
+
+    double meanDistance = 0.0;
+    for (uint32_t iPt = 0; iPt < numPoints; iPt++) {
+        meanDistance += std::hypot(points[iPt].x - centroid.x, points[iPt].y - centroid.y);
+    }
+    meanDistance /= (double)numPoints;
+    if (meanDistance <= 0.0) {
+        return false;
+    }
+
+    const double scale = std::sqrt(2.0)/meanDistance;
+    normalization = cv::Matx33d(
+            scale, 0.0, -scale*centroid.x,
+            0.0, scale, -scale*centroid.y,
+            0.0, 0.0, 1.0);
+    return true;
+}
+
+cv::Point2d Builder::normalize(const cv::Matx33d& normalization, const cv::Point& point) {
+    return {normalization(0, 0)*point.x + normalization(0, 2),
+            normalization(1, 1)*point.y + normalization(1, 2)};
+}
+
+bool Builder::solveInPlace(double (&A)[numUnknowns][numUnknowns],
+        double (&b)[numUnknowns]) {
+    // Forward elimination
+    for (uint32_t iCol = 0; iCol < numUnknowns; iCol++) {
+        uint32_t pivotRow = iCol;
+        for (uint32_t iRow = iCol + 1; iRow < numUnknowns; iRow++) {
+            if (std::abs(A[iRow][iCol]) > std::abs(A[pivotRow][iCol])) {
+                pivotRow = iRow;
+            }
+        }
+        if (std::abs(A[pivotRow][iCol]) < minPivotMagnitude) {
+            return false;
+        }
+        if (pivotRow != iCol) {
+            std::swap(A[pivotRow], A[iCol]);
+            std::swap(b[pivotRow], b[iCol]);
+        }
+
+        for (uint32_t iRow = iCol + 1; iRow < numUnknowns; iRow++) {
+            const double factor = A[iRow][iCol]/A[iCol][iCol];
+            for (uint32_t jCol = iCol; jCol < numUnknowns; jCol++) {
+                A[iRow][jCol] -= factor*A[iCol][jCol];
+            }
+            b[iRow] -= factor*b[iCol];
+        }
+    }
+
+    // Back substitution
+    for (uint32_t iRow = numUnknowns; iRow-- > 0;) {
+        double sum = b[iRow];
+        for (uint32_t jCol = iRow + 1; jCol < numUnknowns; jCol++) {
+            sum -= A[iRow][jCol]*b[jCol];
+        }
+        b[iRow] = sum/A[iRow][iRow];
+    }
+
+    return true;
+}
+
+}
+}
@@ -1,6 +1,8 @@
 #include "core/homography/Evaluator.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
 #include "opencv2/imgproc.hpp"
 
@@ -8,26 +10,56 @@
 
 #include "core/homography/Definitions.hpp"
 #include "core/homography/SanityChecker.hpp"
+#include "core/homography/Warper.hpp"
 
 namespace core {
 namespace homography {
 
 std::vector<cv::Point> Evaluator::applyPoints(
-        const std::vector<cv::Point>& inputPts, const cv::Mat& homography) {
-    if (inputPts.size() == 0) {
-        return std::vector<cv::Point>{};
+        const std::vector<cv::Point>& inputPts, const Homography& homography) {
+    std::vector<cv::Point> outputPoints;
+    applyPoints(inputPts, homography, outputPoints);
+
+    return outputPoints;
+}
+
+void Evaluator::applyPoints(const std::vector<cv::Point>& inputPts,
+        const Homography& homography, std::vector<cv::Point>& outputPts) {
+    const uint32_t numPoints = inputPts.size();
+    outputPts.resize(numPoints);
+    for (uint32_t iPt = 0; iPt < numPoints; iPt++) {
+        outputPts[iPt] = applyPoint(inputPts[iPt], homography);
     }
+}
 
-    const cv::Mat inputMat = convertPointsToMat(inputPts);
-    const cv::Mat outputMat = inputMat*homography.t();
-    const std::vector<cv::Point> outputPoints = convertMatToPoints(outputMat);
+std::vector<cv::Point2f> Evaluator::projectCorners(const cv::Size& imageSize,
+        const std::vector<Homography>& homographies) {
+    const float width = (float)imageSize.width;
+    const float height = (float)imageSize.height;
+    const std::vector<cv::Point2f> corners{{0.0f, 0.0f}, {width, 0.0f},
+            {width, height}, {0.0f, height}};
 
-    return outputPoints;
+    std::vector<cv::Point2f> projectedCorners;
+    for (const Homography& homography : homographies) {
+        for (const cv::Point2f& corner : corners) {
+            const float coordScale = 1.0f/(homography(2, 0)*corner.x +
+                    homography(2, 1)*corner.y + homography(2, 2));
+            projectedCorners.emplace_back(coordScale*(homography(0, 0)*corner.x +
+                    homography(0, 1)*corner.y + homography(0, 2)),
+                    coordScale*(homography(1, 0)*corner.x +
+                    homography(1, 1)*corner.y + homography(1, 2)));
+        }
+    }
+
+    return projectedCorners;
 }
 
-bool Evaluator::isAugmentationSane(const std::vector<cv::Point>& replacementPoints,
-        const cv::Rect& targetRegion, const cv::Mat& homography) {
-    const std::vector<cv::Point> mappedPoints = applyPoints(replacementPoints, homography); 
+bool Evaluator::isAugmentationSane(const MinPointSet& replacementPoints,
+        const cv::Rect& targetRegion, const Homography& homography) {
+    MinPointSet mappedPoints;
+    for (uint32_t iPt = 0; iPt < MIN_BUILD_POINTS; iPt++) {
+        mappedPoints[iPt] = applyPoint(replacementPoints[iPt], homography);
+    }
 
     // First, make sure the mapping between the original and transformed points are sane
     const bool matchesSane = SanityChecker::areMatchesSane(replacementPoints, mappedPoints);
@@ -41,46 +73,283 @@ bool Evaluator::isAugmentationSane(const std::vector<cv::Point>& replacementPoin
 }
 
 cv::Mat Evaluator::augment(const cv::Mat& targetImage,
-        const cv::Mat& replacementImage, const cv::Mat& homography) {
-    // We use a fixed boundary value (-1.0f) that is out of the pixel dynamic
-    // range [0.0f, 1.0f] to represent pixels to be populated by the original
-    // (target) region
-    cv::Mat augmentedImage;
-    cv::warpPerspective(replacementImage, augmentedImage, homography,
-            targetImage.size(), cv::INTER_LINEAR, cv::BORDER_CONSTANT, 
-            cv::Scalar(-1.0f, -1.0f, -1.0f));
-    targetImage.copyTo(augmentedImage, augmentedImage == -1.0f);
+        const cv::Mat& replacementImage, const Homography& homography) {
+    return augment(targetImage, replacementImage, std::vector<Homography>{homography});
+}
+
+cv::Mat Evaluator::augment(const cv::Mat& targetImage, const cv::Mat& replacementImage,
+        const std::vector<Homography>& homographies) {
+    cv::Mat augmentedImage = targetImage.clone();
+    augmentInPlace(augmentedImage, replacementImage, homographies);
+
+    return augmentedImage;
+}
+
+void Evaluator::augmentInPlace(cv::Mat& image, const cv::Mat& replacementImage,
+        const std::vector<Homography>& homographies) {
+    shared::VALIDATE_ARGUMENT(replacementImage.type() == image.type(),
+            "core::homography::Evaluator: images must be of the same type");
+    shared::VALIDATE_ARGUMENT(image.depth() == CV_8U || image.depth() == CV_32F,
+            "core::homography::Evaluator: images must have data of type uint8 or float32");
+
+    // Only the bounding box of the projected replacement images can change, so warp
+    // within it alone, through homographies adjusted to map onto the box origin
+    const cv::Rect augmentedRegion = computeAugmentedRegion(
+            image.size(), replacementImage.size(), homographies);
+    if (augmentedRegion.area() == 0) {
+        return;
+    }
+
+    const std::vector<Homography> inverseHomographies =
+            invertOntoRegion(augmentedRegion, homographies);
+    cv::Mat augmentedRegionImage = image(augmentedRegion);
+    if (image.depth() == CV_8U) {
+        augmentRegionUint8(replacementImage, inverseHomographies, augmentedRegionImage);
+    } else {
+        augmentRegionFloat(replacementImage, inverseHomographies, augmentedRegionImage);
+    }
+}
+
+cv::Mat Evaluator::augment(const cv::Mat& targetImage,
+        const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Homography>& homographies) {
+    cv::Mat augmentedImage = targetImage.clone();
+    augmentInPlace(augmentedImage, replacementPyramid, homographies);
 
     return augmentedImage;
 }
 
+void Evaluator::augmentInPlace(cv::Mat& image, const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Homography>& homographies, WarpCache* warpCache) {
+    shared::VALIDATE_ARGUMENT(!replacementPyramid.empty(),
+            "core::homography::Evaluator: replacement pyramid can't be empty");
+
+    if (warpCache != nullptr) {
+        shared::VALIDATE_ARGUMENT(replacementPyramid.front().type() == image.type(),
+                "core::homography::Evaluator: images must be of the same type");
+        warp(image.size(), replacementPyramid, homographies, *warpCache);
+        if (warpCache->region.area() > 0) {
+            cv::Mat augmentedRegionImage = image(warpCache->region);
+            warpCache->warpedRegion.copyTo(augmentedRegionImage, warpCache->coverageMask);
+        }
+        return;
+    }
+
+    std::vector<Homography> levelHomographies;
+    const uint32_t level = choosePyramidLevel(replacementPyramid, homographies,
+            levelHomographies);
+    augmentInPlace(image, replacementPyramid[level], levelHomographies);
+}
+
+void Evaluator::warp(const cv::Size& imageSize, const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Homography>& homographies, WarpCache& warpCache) {
+    shared::VALIDATE_ARGUMENT(!replacementPyramid.empty(),
+            "core::homography::Evaluator: replacement pyramid can't be empty");
+    const int32_t imageType = replacementPyramid.front().type();
+    shared::VALIDATE_ARGUMENT(CV_MAT_DEPTH(imageType) == CV_8U ||
+            CV_MAT_DEPTH(imageType) == CV_32F,
+            "core::homography::Evaluator: images must have data of type uint8 or float32");
+
+    // Map the region onto the replacement pyramid again only once the instances moved
+    const std::vector<cv::Point2f> replacementCorners =
+            projectCorners(replacementPyramid.front().size(), homographies);
+    if (!isWarpReusable(warpCache, imageSize, imageType, replacementCorners)) {
+        std::vector<Homography> levelHomographies;
+        warpCache.level = choosePyramidLevel(replacementPyramid, homographies,
+                levelHomographies);
+        warpCache.region = computeAugmentedRegion(imageSize,
+                replacementPyramid[warpCache.level].size(), levelHomographies);
+        warpCache.mapXs.create(warpCache.region.size(), CV_32FC1);
+        warpCache.mapYs.create(warpCache.region.size(), CV_32FC1);
+        if (warpCache.region.area() > 0) {
+            Warper::mapRegion(invertOntoRegion(warpCache.region, levelHomographies),
+                    replacementPyramid[warpCache.level].size(), warpCache.mapXs,
+                    warpCache.mapYs);
+        }
+
+        warpCache.imageType = imageType;
+        warpCache.imageSize = imageSize;
+        warpCache.replacementCorners = replacementCorners;
+        warpCache.sampledImage.release();
+    }
+    if (warpCache.region.area() == 0) {
+        warpCache.warpedRegion.release();
+        warpCache.coverageMask.release();
+        return;
+    }
+
+    // Sample the replacement pyramid again only once it changed, the cached level
+    // keeps its data alive so it can't be mistaken for a new one
+    const cv::Mat& replacementImage = replacementPyramid[warpCache.level];
+    if (warpCache.sampledImage.data != replacementImage.data ||
+            warpCache.sampledImage.size() != replacementImage.size()) {
+        if (CV_MAT_DEPTH(imageType) == CV_8U) {
+            warpCache.warpedRegion = cv::Mat::zeros(warpCache.region.size(), imageType);
+            Warper::sampleRegionUint8(replacementImage, warpCache.mapXs, warpCache.mapYs,
+                    warpCache.warpedRegion, &warpCache.coverageMask);
+        } else {
+            // Same boundary value as augmentRegionFloat
+            cv::remap(replacementImage, warpCache.warpedRegion, warpCache.mapXs,
+                    warpCache.mapYs, cv::INTER_LINEAR, cv::BORDER_CONSTANT,
+                    cv::Scalar(-1.0f, -1.0f, -1.0f));
+            warpCache.coverageMask = (warpCache.warpedRegion != -1.0f);
+        }
+        warpCache.sampledImage = replacementImage;
+    }
+}
+
+std::vector<cv::Mat> Evaluator::buildPyramid(const cv::Mat& replacementImage) {
+    std::vector<cv::Mat> pyramid{replacementImage};
+    while (std::min(pyramid.back().cols, pyramid.back().rows) >= 2*minPyramidLevelSide) {
+        cv::Mat nextLevel;
+        cv::pyrDown(pyramid.back(), nextLevel);
+        pyramid.push_back(nextLevel);
+    }
+
+    return pyramid;
+}
+
+uint32_t Evaluator::choosePyramidLevel(const cv::Size& replacementSize, uint32_t numLevels,
+        const Homography& homography) {
+    const MinPointSet replacementCorners{{{0, 0}, {replacementSize.width-1, 0},
+            {replacementSize.width-1, replacementSize.height-1}, {0, replacementSize.height-1}}};
+    MinPointSet mappedCorners;
+    for (uint32_t iPt = 0; iPt < MIN_BUILD_POINTS; iPt++) {
+        mappedCorners[iPt] = applyPoint(replacementCorners[iPt], homography);
+    }
+
+    // Shoelace formula of the area of each quadrilateral, doubled
+    int64_t replacementArea = 0;
+    int64_t mappedArea = 0;
+    for (uint32_t iPt = 0; iPt < MIN_BUILD_POINTS; iPt++) {
+        const uint32_t iNextPt = (iPt + 1) % MIN_BUILD_POINTS;
+        replacementArea += (int64_t)replacementCorners[iPt].x*replacementCorners[iNextPt].y -
+                (int64_t)replacementCorners[iNextPt].x*replacementCorners[iPt].y;
+        mappedArea += (int64_t)mappedCorners[iPt].x*mappedCorners[iNextPt].y -
+                (int64_t)mappedCorners[iNextPt].x*mappedCorners[iPt].y;
+    }
+    if (mappedArea <= 0 || replacementArea <= 0) {
+        return 0u;
+    }
+
+    // Each level halves both dimensions, so it is as detailed as the instance
+    // once the instance shrinks the area fourfold
+    const double shrinkFactor = (double)replacementArea/(double)mappedArea;
+    const double level = std::floor(0.5*std::log2(shrinkFactor));
+    if (!(level > 0.0)) {
+        return 0u;
+    }
+
+    return std::min((uint32_t)level, numLevels - 1);
+}
+
+uint32_t Evaluator::choosePyramidLevel(const std::vector<cv::Mat>& replacementPyramid,
+        const std::vector<Homography>& homographies,
+        std::vector<Homography>& levelHomographies) {
+    uint32_t level = replacementPyramid.size() - 1;
+    for (const Homography& homography : homographies) {
+        level = std::min(level, choosePyramidLevel(replacementPyramid.front().size(),
+                replacementPyramid.size(), homography));
+    }
+
+    // Pixels of the level map onto the base level before the homographies apply
+    const float levelScale = (float)(1u << level);
+    const Homography levelToBase(levelScale, 0.0f, 0.0f, 0.0f, levelScale, 0.0f,
+            0.0f, 0.0f, 1.0f);
+    levelHomographies.clear();
+    for (const Homography& homography : homographies) {
+        levelHomographies.push_back(homography*levelToBase);
+    }
+
+    return level;
+}
+
+bool Evaluator::isWarpReusable(const WarpCache& warpCache, const cv::Size& imageSize,
+        int32_t imageType, const std::vector<cv::Point2f>& replacementCorners) {
+    if (imageType != warpCache.imageType || imageSize != warpCache.imageSize ||
+            replacementCorners.size() != warpCache.replacementCorners.size()) {
+        return false;
+    }
+
+    // Compared against the corners the cache was built with, so that slow drift
+    // eventually invalidates it
+    const float maxSquaredDisplacement =
+            warpCache.maxCornerDisplacement*warpCache.maxCornerDisplacement;
+    for (uint32_t iCorner = 0; iCorner < replacementCorners.size(); iCorner++) {
+        const cv::Point2f displacement =
+                replacementCorners[iCorner] - warpCache.replacementCorners[iCorner];
+        if (!(displacement.dot(displacement) <= maxSquaredDisplacement)) {
+            return false;
+        }
+    }
+
+    return true;
+}
 
-cv::Mat Evaluator::convertPointsToMat(const std::vector<cv::Point>& points) {
-    // N X 3, homogeneous coordinates
-    cv::Mat pointsMat = cv::Mat::ones(points.size(), TRANSFORM_MAT_SIDE, CV_32F);
-    for (uint32_t iPt = 0; iPt < points.size(); iPt++) {
-        const cv::Point& point = points[iPt];
-        pointsMat.at<float>(iPt, 0) = (float)point.x;
-        pointsMat.at<float>(iPt, 1) = (float)point.y;
+std::vector<Homography> Evaluator::invertOntoRegion(const cv::Rect& region,
+        const std::vector<Homography>& homographies) {
+    const Homography regionOffset(1.0f, 0.0f, (float)-region.x,
+            0.0f, 1.0f, (float)-region.y, 0.0f, 0.0f, 1.0f);
+    std::vector<Homography> inverseHomographies;
+    for (const Homography& homography : homographies) {
+        inverseHomographies.push_back((regionOffset*homography).inv());
     }
 
-    return pointsMat;
+    return inverseHomographies;
+}
+
+void Evaluator::augmentRegionFloat(const cv::Mat& replacementImage,
+        const std::vector<Homography>& inverseHomographies, cv::Mat& regionImage) {
+    cv::Mat mapXs(regionImage.size(), CV_32FC1);
+    cv::Mat mapYs(regionImage.size(), CV_32FC1);
+    Warper::mapRegion(inverseHomographies, replacementImage.size(), mapXs, mapYs);
+
+    // We use a fixed boundary value (-1.0f) that is out of the pixel dynamic
+    // range [0.0f, 1.0f] to represent pixels to be populated by the original
+    // (target) region
+    cv::Mat warpedRegionImage;
+    cv::remap(replacementImage, warpedRegionImage, mapXs, mapYs, cv::INTER_LINEAR,
+            cv::BORDER_CONSTANT, cv::Scalar(-1.0f, -1.0f, -1.0f));
+    regionImage.copyTo(warpedRegionImage, warpedRegionImage == -1.0f);
+    warpedRegionImage.copyTo(regionImage);
+}
+
+void Evaluator::augmentRegionUint8(const cv::Mat& replacementImage,
+        const std::vector<Homography>& inverseHomographies, cv::Mat& regionImage) {
+    Warper::warpUint8(replacementImage, inverseHomographies, regionImage);
 }
 
-std::vector<cv::Point> Evaluator::convertMatToPoints(const cv::Mat& pointsMat) {
-    std::vector<cv::Point> points;
-    for (int32_t iPt = 0; iPt < pointsMat.rows; iPt++) {
-        float coordScale = 1.0f/pointsMat.at<float>(iPt, 2);
-        int32_t x = (int32_t)std::round(coordScale*pointsMat.at<float>(iPt, 0));
-        int32_t y = (int32_t)std::round(coordScale*pointsMat.at<float>(iPt, 1));
-        points.emplace_back(x, y);
+cv::Rect Evaluator::computeAugmentedRegion(const cv::Size& targetSize,
+        const cv::Size& replacementSize, const std::vector<Homography>& homographies) {
+    // Replacement pixels within interpolation reach of the image, i.e. up to one
+    // pixel outside of it, can affect the augmented image
+    const MinPointSet replacementCorners{{{-1, -1}, {replacementSize.width, -1},
+            {replacementSize.width, replacementSize.height}, {-1, replacementSize.height}}};
+
+    cv::Rect augmentedRegion;
+    for (const Homography& homography : homographies) {
+        int32_t minX = std::numeric_limits<int32_t>::max();
+        int32_t minY = std::numeric_limits<int32_t>::max();
+        int32_t maxX = std::numeric_limits<int32_t>::min();
+        int32_t maxY = std::numeric_limits<int32_t>::min();
+        for (const cv::Point& corner : replacementCorners) {
+            const cv::Point mappedCorner = applyPoint(corner, homography);
+            minX = std::min(minX, mappedCorner.x);
+            minY = std::min(minY, mappedCorner.y);
+            maxX = std::max(maxX, mappedCorner.x);
+            maxY = std::max(maxY, mappedCorner.y);
+        }
+
+        // Pad by a pixel to absorb the rounding of the mapped corners
+        const cv::Rect instanceRegion(minX - 1, minY - 1, maxX - minX + 3, maxY - minY + 3);
+        augmentedRegion = (augmentedRegion.area() == 0) ? instanceRegion :
+                (augmentedRegion | instanceRegion);
     }
 
-    return points;
+    return augmentedRegion & cv::Rect(0, 0, targetSize.width, targetSize.height);
 }
 
-bool Evaluator::arePointsInside(const std::vector<cv::Point>& points,
-        const cv::Rect& rect) {
+bool Evaluator::arePointsInside(const MinPointSet& points, const cv::Rect& rect) {
     for (const cv::Point& point : points) {
         if (!rect.contains(point)) {
             return false;
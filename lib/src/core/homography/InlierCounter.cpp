@@ -0,0 +1,53 @@
+#include "core/homography/InlierCounter.hpp"
+
+#include <limits>
+
+namespace core {
+namespace homography {
+
+InlierCounter::MatchCoordinates InlierCounter::buildMatchCoordinates(
+        const std::vector<cv::Point>& fromPts, const std::vector<cv::Point>& toPts) {
+    assert(fromPts.size() == toPts.size());
+
+    MatchCoordinates matchCoordinates;
+    matchCoordinates.numPoints = fromPts.size();
+
+    // Padding maps to the origin and targets NaN, which is never within epsilon
+    const uint32_t numPadded = (matchCoordinates.numPoints + BLOCK_SIZE - 1)/BLOCK_SIZE*BLOCK_SIZE;
+    const float padding = std::numeric_limits<float>::quiet_NaN();
+    matchCoordinates.fromXs.assign(numPadded, 0.0f);
+    matchCoordinates.fromYs.assign(numPadded, 0.0f);
+    matchCoordinates.toXs.assign(numPadded, padding);
+    matchCoordinates.toYs.assign(numPadded, padding);
+    for (uint32_t iPt = 0; iPt < matchCoordinates.numPoints; iPt++) {
+        matchCoordinates.fromXs[iPt] = (float)fromPts[iPt].x;
+        matchCoordinates.fromYs[iPt] = (float)fromPts[iPt].y;
+        matchCoordinates.toXs[iPt] = (float)toPts[iPt].x;
+        matchCoordinates.toYs[iPt] = (float)toPts[iPt].y;
+    }
+
+    return matchCoordinates;
+}
+
+uint32_t InlierCounter::countInliers(const MatchCoordinates& matchCoordinates,
+        const Homography& homography, float epsilon, std::vector<uint8_t>* inlierMask) {
+    const uint32_t numBlocks = getNumBlocks(matchCoordinates);
+    if (inlierMask != nullptr) {
+        inlierMask->resize(numBlocks);
+    }
+
+    uint32_t numInliers = 0u;
+    for (uint32_t iBlock = 0; iBlock < numBlocks; iBlock++) {
+        const uint32_t blockMask = checkBlock(matchCoordinates, iBlock, homography,
+                epsilon*epsilon);
+        numInliers += __builtin_popcount(blockMask);
+        if (inlierMask != nullptr) {
+            (*inlierMask)[iBlock] = (uint8_t)blockMask;
+        }
+    }
+
+    return numInliers;
+}
+
+}
+}
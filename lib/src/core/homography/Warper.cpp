@@ -0,0 +1,338 @@
+#include "core/homography/Warper.hpp"
+
+#include <algorithm>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "shared/Definitions.hpp"
+
+namespace core {
+namespace homography {
+
+void Warper::mapRegion(const std::vector<Homography>& inverseHomographies,
+        const cv::Size& replacementSize, cv::Mat& mapXs, cv::Mat& mapYs) {
+    const int32_t numBands = (mapXs.rows + rowsPerBand - 1)/rowsPerBand;
+    #pragma omp parallel for schedule(static)
+    for (int32_t iBand = 0; iBand < numBands; iBand++) {
+        const int32_t bandEnd = std::min(iBand*rowsPerBand + rowsPerBand, mapXs.rows);
+        for (int32_t y = iBand*rowsPerBand; y < bandEnd; y++) {
+            mapRow(y, mapXs.cols, inverseHomographies, replacementSize,
+                    mapXs.ptr<float>(y), mapYs.ptr<float>(y));
+        }
+    }
+}
+
+void Warper::warpUint8(const cv::Mat& replacementImage,
+        const std::vector<Homography>& inverseHomographies, cv::Mat& regionImage) {
+    const int32_t numBands = (regionImage.rows + rowsPerBand - 1)/rowsPerBand;
+    #pragma omp parallel
+    {
+        // Positions of a single row, reused by each thread for all of its rows
+        std::vector<float> mappedXs(regionImage.cols);
+        std::vector<float> mappedYs(regionImage.cols);
+        #pragma omp for schedule(static)
+        for (int32_t iBand = 0; iBand < numBands; iBand++) {
+            const int32_t bandEnd = std::min(iBand*rowsPerBand + rowsPerBand, regionImage.rows);
+            for (int32_t y = iBand*rowsPerBand; y < bandEnd; y++) {
+                mapRow(y, regionImage.cols, inverseHomographies, replacementImage.size(),
+                        mappedXs.data(), mappedYs.data());
+                sampleRow(replacementImage, mappedXs.data(), mappedYs.data(),
+                        regionImage.cols, regionImage.ptr<uint8_t>(y), nullptr);
+            }
+        }
+    }
+}
+
+void Warper::sampleRegionUint8(const cv::Mat& replacementImage, const cv::Mat& mapXs,
+        const cv::Mat& mapYs, cv::Mat& regionImage, cv::Mat* coverageMask) {
+    if (coverageMask != nullptr) {
+        *coverageMask = cv::Mat::zeros(regionImage.size(), CV_8UC1);
+    }
+
+    const int32_t numBands = (regionImage.rows + rowsPerBand - 1)/rowsPerBand;
+    #pragma omp parallel for schedule(static)
+    for (int32_t iBand = 0; iBand < numBands; iBand++) {
+        const int32_t bandEnd = std::min(iBand*rowsPerBand + rowsPerBand, regionImage.rows);
+        for (int32_t y = iBand*rowsPerBand; y < bandEnd; y++) {
+            sampleRow(replacementImage, mapXs.ptr<float>(y), mapYs.ptr<float>(y),
+                    regionImage.cols, regionImage.ptr<uint8_t>(y),
+                    (coverageMask != nullptr) ? coverageMask->ptr<uint8_t>(y) : nullptr);
+        }
+    }
+}
+
+void Warper::mapRow(int32_t y, int32_t width,
+        const std::vector<Homography>& inverseHomographies,
+        const cv::Size& replacementSize, float* mappedXs, float* mappedYs) {
+    std::fill(mappedXs, mappedXs + width, (float)unmappedCoord);
+    std::fill(mappedYs, mappedYs + width, (float)unmappedCoord);
+
+    // Earlier homographies take precedence, so each one only maps the pixels that
+    // are still unmapped
+    const float maxX = (float)replacementSize.width;
+    const float maxY = (float)replacementSize.height;
+    for (const Homography& inverseHomography : inverseHomographies) {
+        const float rowTermX = inverseHomography(0, 1)*(float)y + inverseHomography(0, 2);
+        const float rowTermY = inverseHomography(1, 1)*(float)y + inverseHomography(1, 2);
+        const float rowTermW = inverseHomography(2, 1)*(float)y + inverseHomography(2, 2);
+#ifdef __AVX2__
+        const __m256 laneOffsets = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        const __m256 laneStepsX = _mm256_mul_ps(_mm256_set1_ps(inverseHomography(0, 0)),
+                laneOffsets);
+        const __m256 laneStepsY = _mm256_mul_ps(_mm256_set1_ps(inverseHomography(1, 0)),
+                laneOffsets);
+        const __m256 laneStepsW = _mm256_mul_ps(_mm256_set1_ps(inverseHomography(2, 0)),
+                laneOffsets);
+        const __m256i laneIndices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        for (int32_t xBlock = 0; xBlock < width; xBlock += BLOCK_SIZE) {
+            const __m256i isInRow = _mm256_cmpgt_epi32(_mm256_set1_epi32(width - xBlock),
+                    laneIndices);
+
+            // Step the homogeneous coordinates from the first pixel of the block
+            const float blockX = (float)xBlock;
+            const __m256 w = _mm256_add_ps(_mm256_set1_ps(
+                    inverseHomography(2, 0)*blockX + rowTermW), laneStepsW);
+            const __m256 numeratorX = _mm256_add_ps(_mm256_set1_ps(
+                    inverseHomography(0, 0)*blockX + rowTermX), laneStepsX);
+            const __m256 numeratorY = _mm256_add_ps(_mm256_set1_ps(
+                    inverseHomography(1, 0)*blockX + rowTermY), laneStepsY);
+
+            // Reciprocal estimate refined by a Newton-Raphson step, r = r*(2 - w*r)
+            __m256 coordScale = _mm256_rcp_ps(w);
+            coordScale = _mm256_mul_ps(coordScale, _mm256_sub_ps(_mm256_set1_ps(2.0f),
+                    _mm256_mul_ps(w, coordScale)));
+            const __m256 blockXs = _mm256_mul_ps(numeratorX, coordScale);
+            const __m256 blockYs = _mm256_mul_ps(numeratorY, coordScale);
+
+            // Ordered comparisons, so degenerate projections never map a pixel
+            const __m256 prevXs = _mm256_maskload_ps(mappedXs + xBlock, isInRow);
+            const __m256 prevYs = _mm256_maskload_ps(mappedYs + xBlock, isInRow);
+            const __m256 isMapped = _mm256_and_ps(_mm256_and_ps(
+                    _mm256_cmp_ps(prevXs, _mm256_set1_ps(unmappedCoord), _CMP_EQ_OQ),
+                    _mm256_and_ps(_mm256_cmp_ps(blockXs, _mm256_set1_ps(-1.0f), _CMP_GT_OQ),
+                            _mm256_cmp_ps(blockXs, _mm256_set1_ps(maxX), _CMP_LT_OQ))),
+                    _mm256_and_ps(_mm256_cmp_ps(blockYs, _mm256_set1_ps(-1.0f), _CMP_GT_OQ),
+                            _mm256_cmp_ps(blockYs, _mm256_set1_ps(maxY), _CMP_LT_OQ)));
+            _mm256_maskstore_ps(mappedXs + xBlock, isInRow,
+                    _mm256_blendv_ps(prevXs, blockXs, isMapped));
+            _mm256_maskstore_ps(mappedYs + xBlock, isInRow,
+                    _mm256_blendv_ps(prevYs, blockYs, isMapped));
+        }
+#else
+        // Same operations in the same order as above, except for the exact reciprocal
+        for (int32_t xBlock = 0; xBlock < width; xBlock += BLOCK_SIZE) {
+            const float blockX = (float)xBlock;
+            const float blockW = inverseHomography(2, 0)*blockX + rowTermW;
+            const float blockNumeratorX = inverseHomography(0, 0)*blockX + rowTermX;
+            const float blockNumeratorY = inverseHomography(1, 0)*blockX + rowTermY;
+            const int32_t blockEnd = std::min(xBlock + BLOCK_SIZE, width);
+            for (int32_t x = xBlock; x < blockEnd; x++) {
+                const float laneOffset = (float)(x - xBlock);
+                const float w = blockW + inverseHomography(2, 0)*laneOffset;
+                const float coordScale = 1.0f/w;
+                const float mappedX = (blockNumeratorX + inverseHomography(0, 0)*laneOffset)*
+                        coordScale;
+                const float mappedY = (blockNumeratorY + inverseHomography(1, 0)*laneOffset)*
+                        coordScale;
+                if (mappedXs[x] == unmappedCoord && mappedX > -1.0f && mappedX < maxX &&
+                        mappedY > -1.0f && mappedY < maxY) {
+                    mappedXs[x] = mappedX;
+                    mappedYs[x] = mappedY;
+                }
+            }
+        }
+#endif
+    }
+}
+
+/**
+ * Algorithm: Bilinear interpolation in fixed point, with the same quantization of the
+ * sample positions as cv::remap, so that compositing uint8 images matches compositing
+ * the same images in float32 up to the rounding of the result.
+ */
+void Warper::sampleRow(const cv::Mat& replacementImage, const float* mappedXs,
+        const float* mappedYs, int32_t width, uint8_t* row, uint8_t* coverageRow) {
+    const int32_t numChannels = replacementImage.channels();
+    int32_t x = 0;
+#ifdef __AVX2__
+    // Taps of 3-channel pixels are gathered as 32 bit words, except for the last pixel
+    // of the image whose word would be read past the end, which is read from one byte
+    // earlier instead
+    if (numChannels == 3 && replacementImage.total() >= 2u) {
+        const int32_t step = (int32_t)replacementImage.step[0];
+        const int32_t maxWordOffset = (replacementImage.rows - 1)*step +
+                (replacementImage.cols - 1)*numChannels - 1;
+        const int* replacementWords = (const int*)replacementImage.data;
+        const auto gatherTap = [replacementWords, maxWordOffset](const __m256i& offsets,
+                const __m256i& isInside) {
+            const __m256i isLast = _mm256_cmpgt_epi32(offsets, _mm256_set1_epi32(maxWordOffset));
+            const __m256i wordOffsets = _mm256_add_epi32(offsets, isLast);
+            const __m256i words = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(),
+                    replacementWords, wordOffsets, isInside, 1);
+            return _mm256_srlv_epi32(words, _mm256_and_si256(isLast, _mm256_set1_epi32(8)));
+        };
+
+        const __m256 tableSize = _mm256_set1_ps((float)interpTableSize);
+        const __m256i tableSizeInt = _mm256_set1_epi32(interpTableSize);
+        const __m256i fracMask = _mm256_set1_epi32(interpTableSize - 1);
+        const __m256i weightScale = _mm256_set1_epi32(interpTableSize*interpTableSize);
+        const __m256i maxValue = _mm256_set1_epi32((int32_t)shared::MAX_CHAR_VALUE);
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        for (; x + BLOCK_SIZE <= width; x += BLOCK_SIZE) {
+            // Split the sample positions into the top left taps and the quantized
+            // fractions towards the bottom right ones
+            const __m256i fixedXs = _mm256_cvtps_epi32(_mm256_mul_ps(
+                    _mm256_loadu_ps(mappedXs + x), tableSize));
+            const __m256i fixedYs = _mm256_cvtps_epi32(_mm256_mul_ps(
+                    _mm256_loadu_ps(mappedYs + x), tableSize));
+            const __m256i x0s = _mm256_srai_epi32(fixedXs, interpTableBits);
+            const __m256i y0s = _mm256_srai_epi32(fixedYs, interpTableBits);
+            const __m256i fracXs = _mm256_and_si256(fixedXs, fracMask);
+            const __m256i fracYs = _mm256_and_si256(fixedYs, fracMask);
+            const __m256i invFracXs = _mm256_sub_epi32(tableSizeInt, fracXs);
+            const __m256i invFracYs = _mm256_sub_epi32(tableSizeInt, fracYs);
+            const __m256i weights00 = _mm256_mullo_epi32(invFracXs, invFracYs);
+            const __m256i weights01 = _mm256_mullo_epi32(fracXs, invFracYs);
+            const __m256i weights10 = _mm256_mullo_epi32(invFracXs, fracYs);
+            const __m256i weights11 = _mm256_mullo_epi32(fracXs, fracYs);
+
+            const __m256i isX0Inside = _mm256_and_si256(
+                    _mm256_cmpgt_epi32(x0s, _mm256_set1_epi32(-1)),
+                    _mm256_cmpgt_epi32(_mm256_set1_epi32(replacementImage.cols), x0s));
+            const __m256i isX1Inside = _mm256_and_si256(
+                    _mm256_cmpgt_epi32(x0s, _mm256_set1_epi32(-2)),
+                    _mm256_cmpgt_epi32(_mm256_set1_epi32(replacementImage.cols - 1), x0s));
+            const __m256i isY0Inside = _mm256_and_si256(
+                    _mm256_cmpgt_epi32(y0s, _mm256_set1_epi32(-1)),
+                    _mm256_cmpgt_epi32(_mm256_set1_epi32(replacementImage.rows), y0s));
+            const __m256i isY1Inside = _mm256_and_si256(
+                    _mm256_cmpgt_epi32(y0s, _mm256_set1_epi32(-2)),
+                    _mm256_cmpgt_epi32(_mm256_set1_epi32(replacementImage.rows - 1), y0s));
+            const __m256i isInside00 = _mm256_and_si256(isX0Inside, isY0Inside);
+            const __m256i isInside01 = _mm256_and_si256(isX1Inside, isY0Inside);
+            const __m256i isInside10 = _mm256_and_si256(isX0Inside, isY1Inside);
+            const __m256i isInside11 = _mm256_and_si256(isX1Inside, isY1Inside);
+
+            // Pixels that only sample the boundary value keep the target pixel
+            const __m256i outsideWeights = _mm256_add_epi32(_mm256_add_epi32(
+                    _mm256_andnot_si256(isInside00, weights00),
+                    _mm256_andnot_si256(isInside01, weights01)), _mm256_add_epi32(
+                    _mm256_andnot_si256(isInside10, weights10),
+                    _mm256_andnot_si256(isInside11, weights11)));
+            const uint32_t keptMask = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(
+                    _mm256_cmpeq_epi32(outsideWeights, weightScale)));
+            if (keptMask == 0xffu) {
+                continue;
+            }
+
+            const __m256i offsets00 = _mm256_add_epi32(
+                    _mm256_mullo_epi32(y0s, _mm256_set1_epi32(step)),
+                    _mm256_mullo_epi32(x0s, _mm256_set1_epi32(numChannels)));
+            const __m256i offsets01 = _mm256_add_epi32(offsets00, _mm256_set1_epi32(numChannels));
+            const __m256i offsets10 = _mm256_add_epi32(offsets00, _mm256_set1_epi32(step));
+            const __m256i offsets11 = _mm256_add_epi32(offsets10, _mm256_set1_epi32(numChannels));
+            const __m256i taps00 = gatherTap(offsets00, isInside00);
+            const __m256i taps01 = gatherTap(offsets01, isInside01);
+            const __m256i taps10 = gatherTap(offsets10, isInside10);
+            const __m256i taps11 = gatherTap(offsets11, isInside11);
+
+            // Taps outside of the replacement image sample the negated max pixel value
+            alignas(32) int32_t values[3][BLOCK_SIZE];
+            const __m256i boundaryValues = _mm256_sub_epi32(_mm256_setzero_si256(),
+                    _mm256_mullo_epi32(outsideWeights, maxValue));
+            for (int32_t iChannel = 0; iChannel < 3; iChannel++) {
+                const __m128i shift = _mm_cvtsi32_si128(8*iChannel);
+                __m256i value = _mm256_add_epi32(_mm256_add_epi32(boundaryValues,
+                        _mm256_mullo_epi32(weights00,
+                                _mm256_and_si256(_mm256_srl_epi32(taps00, shift), byteMask))),
+                        _mm256_mullo_epi32(weights01,
+                                _mm256_and_si256(_mm256_srl_epi32(taps01, shift), byteMask)));
+                value = _mm256_add_epi32(_mm256_add_epi32(value,
+                        _mm256_mullo_epi32(weights10,
+                                _mm256_and_si256(_mm256_srl_epi32(taps10, shift), byteMask))),
+                        _mm256_mullo_epi32(weights11,
+                                _mm256_and_si256(_mm256_srl_epi32(taps11, shift), byteMask)));
+                value = _mm256_srai_epi32(_mm256_add_epi32(value,
+                        _mm256_srli_epi32(weightScale, 1)), 2*interpTableBits);
+                value = _mm256_min_epi32(_mm256_max_epi32(value, _mm256_setzero_si256()),
+                        maxValue);
+                _mm256_store_si256((__m256i*)values[iChannel], value);
+            }
+
+            for (int32_t iLane = 0; iLane < BLOCK_SIZE; iLane++) {
+                if (((keptMask >> iLane) & 1u) == 0u) {
+                    uint8_t* pixel = row + (x + iLane)*3;
+                    pixel[0] = (uint8_t)values[0][iLane];
+                    pixel[1] = (uint8_t)values[1][iLane];
+                    pixel[2] = (uint8_t)values[2][iLane];
+                    if (coverageRow != nullptr) {
+                        coverageRow[x + iLane] = 255u;
+                    }
+                }
+            }
+        }
+    }
+#endif
+    // Remaining pixels, or all of them without AVX2, one at a time
+    for (; x < width; x++) {
+        const bool isWritten = samplePixel(replacementImage, mappedXs[x], mappedYs[x],
+                row + x*numChannels);
+        if (isWritten && coverageRow != nullptr) {
+            coverageRow[x] = 255u;
+        }
+    }
+}
+
+bool Warper::samplePixel(const cv::Mat& replacementImage, float mappedX, float mappedY,
+        uint8_t* pixel) {
+    const int32_t numChannels = replacementImage.channels();
+    const int32_t weightScale = interpTableSize*interpTableSize;
+
+    // Split the sample position into the top left tap and the quantized fraction
+    // towards the bottom right one
+    const int32_t fixedX = cvRound(mappedX*interpTableSize);
+    const int32_t fixedY = cvRound(mappedY*interpTableSize);
+    const int32_t x0 = fixedX >> interpTableBits;
+    const int32_t y0 = fixedY >> interpTableBits;
+    const int32_t fracX = fixedX & (interpTableSize - 1);
+    const int32_t fracY = fixedY & (interpTableSize - 1);
+    const int32_t tapWeights[4] = {(interpTableSize - fracX)*(interpTableSize - fracY),
+            fracX*(interpTableSize - fracY), (interpTableSize - fracX)*fracY, fracX*fracY};
+    const int32_t tapXs[4] = {x0, x0 + 1, x0, x0 + 1};
+    const int32_t tapYs[4] = {y0, y0, y0 + 1, y0 + 1};
+
+    // Taps outside of the replacement image sample the boundary value, the negated
+    // max pixel value, like the sentinel of the float32 path
+    const uint8_t* taps[4];
+    int32_t outsideWeight = 0;
+    for (uint32_t iTap = 0; iTap < 4u; iTap++) {
+        const bool isInside = tapXs[iTap] >= 0 && tapXs[iTap] < replacementImage.cols &&
+                tapYs[iTap] >= 0 && tapYs[iTap] < replacementImage.rows;
+        taps[iTap] = isInside ? replacementImage.ptr<uint8_t>(tapYs[iTap]) +
+                tapXs[iTap]*numChannels : nullptr;
+        outsideWeight += isInside ? 0 : tapWeights[iTap];
+    }
+
+    // Pixels that only sample the boundary value keep the target pixel
+    if (outsideWeight == weightScale) {
+        return false;
+    }
+
+    for (int32_t iChannel = 0; iChannel < numChannels; iChannel++) {
+        int32_t value = -outsideWeight*(int32_t)shared::MAX_CHAR_VALUE;
+        for (uint32_t iTap = 0; iTap < 4u; iTap++) {
+            if (taps[iTap] != nullptr) {
+                value += tapWeights[iTap]*(int32_t)taps[iTap][iChannel];
+            }
+        }
+        value = (value + weightScale/2) >> (2*interpTableBits);
+        pixel[iChannel] = (uint8_t)std::min(std::max(value, 0), (int32_t)shared::MAX_CHAR_VALUE);
+    }
+
+    return true;
+}
+
+}
+}
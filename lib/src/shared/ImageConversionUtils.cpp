@@ -33,15 +33,32 @@ cv::Mat ImageConversionUtils::convertToColorFloats(const cv::Mat& input) {
 }
 
 cv::Mat ImageConversionUtils::convertToColorUint8(const cv::Mat& input) {
-    validateImage(input, validConvertMatTypes);
-
-    const cv::Mat colorImage = convertToColor(input);
     cv::Mat colorImageUint8;
-    colorImage.convertTo(colorImageUint8, CV_8UC3, MAX_CHAR_VALUE);
+    copyToColorUint8(input, colorImageUint8);
 
     return colorImageUint8;
 }
 
+void ImageConversionUtils::copyToColorUint8(const cv::Mat& input, cv::Mat& output) {
+    validateImage(input, validConvertMatTypes);
+
+    // Uint8 pixels keep their values, so they are converted straight into the output
+    if (input.type() == CV_8UC1) {
+        cv::cvtColor(input, output, CV_GRAY2BGR);
+        return;
+    }
+    if (input.type() == CV_8UC3) {
+        if (output.data != input.data) {
+            input.copyTo(output);
+        }
+        return;
+    }
+
+    // Float32 pixels need to be rescaled to the uint8 dynamic range
+    const cv::Mat colorImage = convertToColor(input);
+    colorImage.convertTo(output, CV_8UC3, MAX_CHAR_VALUE);
+}
+
 cv::Mat ImageConversionUtils::convertToGray(const cv::Mat& input) {
     cv::Mat grayImage;
     if (input.channels() == 1) {
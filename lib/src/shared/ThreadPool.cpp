@@ -0,0 +1,61 @@
+#include "shared/ThreadPool.hpp"
+
+#include <string>
+
+#include "opencv2/core.hpp"
+
+#include "shared/Definitions.hpp"
+
+namespace shared {
+
+ThreadPool::ThreadPool(uint32_t numThreads) {
+    VALIDATE_ARGUMENT(numThreads >= 1u, "ThreadPool: Number of threads must be at least 1");
+    for (uint32_t iThread = 0; iThread < numThreads; iThread++) {
+        workers.emplace_back(&ThreadPool::runWorker, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isStopping = true;
+    }
+    taskAvailable.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(const std::function<void()>& task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingTasks.push_back(task);
+    }
+    taskAvailable.notify_one();
+}
+
+uint32_t ThreadPool::getNumThreads() const {
+    return workers.size();
+}
+
+void ThreadPool::runWorker() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this]() { return isStopping || !pendingTasks.empty(); });
+            // Pending tasks are still run when stopping, so none is silently dropped
+            if (pendingTasks.empty()) {
+                return;
+            }
+
+            task = std::move(pendingTasks.front());
+            pendingTasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+}
@@ -52,17 +52,24 @@ int main(int argc, char* argv[]) {
     sceneAugmenter.setSourceImage(sourceImage);
     sceneAugmenter.setReplacementImage(replacementImage);
 
-    // Run scene augmenter pipeline
-    for (uint32_t iFrame = 0; iFrame < targetImageList.size(); iFrame++) {
-        const std::string targetImagePath = targetImageList[iFrame];
-        std::cout << targetImagePath << std::endl;
-
-        const cv::Mat targetImage = cv::imread(targetImagePath);
-        const cv::Mat augmentedImage = sceneAugmenter.execute(targetImage);
-
-        // Write to disk
-        cv::imwrite(outputFolder + "/" + std::to_string(iFrame) + ".png", augmentedImage);
-    }
+    // Run scene augmenter pipeline, reading, augmenting and writing different frames
+    // at once
+    sceneAugmenter.executeBatch(
+            [&](uint32_t iFrame, cv::Mat& targetImage) {
+                if (iFrame >= targetImageList.size()) {
+                    return false;
+                }
+
+                const std::string targetImagePath = targetImageList[iFrame];
+                std::cout << targetImagePath << std::endl;
+                targetImage = cv::imread(targetImagePath);
+                return true;
+            },
+            [&](uint32_t iFrame, const cv::Mat& augmentedImage) {
+                // Write to disk
+                cv::imwrite(outputFolder + "/" + std::to_string(iFrame) + ".png",
+                        augmentedImage);
+            });
 
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,101 @@
+/**
+ * Service that will time the in-tree perspective warp against the OpenCV one.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+#include "opencv2/imgcodecs.hpp"
+#include "opencv2/imgproc.hpp"
+
+#include "core/homography/Definitions.hpp"
+#include "core/homography/Evaluator.hpp"
+
+static const cv::Size targetSize(1280, 720);
+static constexpr uint32_t numIterations = 100u;
+
+
+// Helper function headers
+cv::Mat augmentOpenCV(const cv::Mat& targetImage, const cv::Mat& replacementImage,
+        const core::homography::Homography& homography);
+template<typename AugmentFunction>
+double measureAugmentTimeMs(const AugmentFunction& augmentFunction);
+
+
+int main(int argc, char* argv[]) {
+    // Read and parse arguments
+    if (argc != 2) {
+        std::cout << "Usage: <service name> <input replacement image path>" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::string replacementImagePath(argv[1]);
+    const cv::Mat replacementImage = cv::imread(replacementImagePath);
+
+    // A perspective view of the replacement image covering about a third of the target
+    const std::vector<cv::Point2f> replacementCorners{{0.0f, 0.0f},
+            {(float)replacementImage.cols, 0.0f},
+            {(float)replacementImage.cols, (float)replacementImage.rows},
+            {0.0f, (float)replacementImage.rows}};
+    const std::vector<cv::Point2f> targetCorners{{400.0f, 150.0f}, {900.0f, 200.0f},
+            {950.0f, 600.0f}, {350.0f, 550.0f}};
+    const core::homography::Homography homography(
+            cv::getPerspectiveTransform(replacementCorners, targetCorners));
+    const cv::Mat targetImage(targetSize, CV_8UC3, cv::Scalar(64, 128, 192));
+
+    // Run both warps
+    const double inTreeTimeMs = measureAugmentTimeMs([&]() {
+        return core::homography::Evaluator::augment(targetImage, replacementImage, homography);
+    });
+    const double openCVTimeMs = measureAugmentTimeMs([&]() {
+        return augmentOpenCV(targetImage, replacementImage, homography);
+    });
+
+    const cv::Mat inTreeImage = core::homography::Evaluator::augment(
+            targetImage, replacementImage, homography);
+    const cv::Mat openCVImage = augmentOpenCV(targetImage, replacementImage, homography);
+    std::cout << "In-tree warp: " << inTreeTimeMs << " ms" << std::endl;
+    std::cout << "OpenCV warp: " << openCVTimeMs << " ms" << std::endl;
+    std::cout << "Max pixel difference: " <<
+            cv::norm(inTreeImage, openCVImage, cv::NORM_INF) << std::endl;
+
+    exit(EXIT_SUCCESS);
+}
+
+
+/**
+ * Composites the replacement image onto the target image the way the library did
+ * before the in-tree warp, with cv::warpPerspective over the whole target image.
+ */
+cv::Mat augmentOpenCV(const cv::Mat& targetImage, const cv::Mat& replacementImage,
+        const core::homography::Homography& homography) {
+    cv::Mat replacementImageFloat, targetImageFloat;
+    replacementImage.convertTo(replacementImageFloat, CV_32FC3);
+    targetImage.convertTo(targetImageFloat, CV_32FC3);
+
+    cv::Mat warpedImage;
+    cv::warpPerspective(replacementImageFloat, warpedImage, homography, targetImage.size(),
+            cv::INTER_LINEAR, cv::BORDER_CONSTANT, cv::Scalar(-1.0f, -1.0f, -1.0f));
+    targetImageFloat.copyTo(warpedImage, warpedImage == -1.0f);
+
+    cv::Mat augmentedImage;
+    warpedImage.convertTo(augmentedImage, CV_8UC3);
+    return augmentedImage;
+}
+
+template<typename AugmentFunction>
+double measureAugmentTimeMs(const AugmentFunction& augmentFunction) {
+    // Warm up caches and the thread pool before timing
+    augmentFunction();
+
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    for (uint32_t iIteration = 0; iIteration < numIterations; iIteration++) {
+        augmentFunction();
+    }
+
+    return std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - startTime).count()/numIterations;
+}
@@ -9,6 +9,7 @@ static constexpr uint32_t TYPICAL_MIN_TOP_DISTANCE = 15u;
 static constexpr uint32_t MAX_FEATURE_VECS = 4u;
 static constexpr uint32_t NUM_SET_BITS_HOP = core::NUM_BRIEF_BITS/MAX_FEATURE_VECS;
 static constexpr uint32_t BIT_CHUNK_SIZE = 8u;
+static constexpr int32_t TYPICAL_SEARCH_RADIUS = 10;
 
 // Useful common BRIEF features
 static const std::string ALL_ZEROS(core::NUM_BRIEF_BITS, '0');
@@ -68,6 +69,25 @@ TEST(simpleCorrespondenceFinder, minRequiredPoints) {
             {{0, 0}});
 }
 
+/**
+ * Ensure the quality of each match is the gap between the best and the second
+ * best match distances.
+ */
+TEST(simpleCorrespondenceFinder, matchQualities) {
+    const CorrespondenceFinder correspondenceFinder(TYPICAL_MIN_TOP_DISTANCE);
+    const std::vector<core::FeatureVector> briefFeatures2{
+            buildFeatureVector(0u), buildFeatureVector(core::NUM_BRIEF_BITS)};
+
+    std::vector<float> matchQualities;
+    const Correspondences correspondences = correspondenceFinder.execute(
+            {buildFeatureVector(0u), buildFeatureVector(TYPICAL_MIN_TOP_DISTANCE)},
+            briefFeatures2, matchQualities);
+
+    EXPECT_EQ(correspondences, Correspondences({{0, 0}, {1, 0}}));
+    EXPECT_EQ(matchQualities, std::vector<float>({(float)core::NUM_BRIEF_BITS,
+            (float)(core::NUM_BRIEF_BITS - 2u*TYPICAL_MIN_TOP_DISTANCE)}));
+}
+
 /**
  * Simple test for correctness when all feature vectors in both input vectors
  * are identical.  We (universally) vary the number of set bits in each feature
@@ -154,6 +174,35 @@ TEST(typicalCorrespondenceFinder, diffTargetPoints) {
     }
 }
 
+/**
+ * Ensure the local search only matches target feature vectors within the search
+ * radius of the predicted keypoints, so identical feature vectors far apart are
+ * told apart.
+ */
+TEST(typicalCorrespondenceFinder, localSearch) {
+    const CorrespondenceFinder correspondenceFinder(TYPICAL_MIN_TOP_DISTANCE);
+
+    // The last source feature vector has no target keypoint within reach, and the
+    // second one has a second best match within reach
+    const std::vector<core::FeatureVector> briefFeatures1(3, ALL_ZERO_BITS);
+    const std::vector<cv::Point> predictedKeypoints{{12, 8}, {95, 104}, {50, 50}};
+    const std::vector<core::FeatureVector> briefFeatures2{ALL_ZERO_BITS, ALL_ZERO_BITS,
+            buildFeatureVector(TYPICAL_MIN_TOP_DISTANCE)};
+    const std::vector<cv::Point> targetKeypoints{{10, 10}, {100, 100}, {104, 100}};
+
+    std::vector<float> matchQualities;
+    const Correspondences correspondences = correspondenceFinder.execute(briefFeatures1,
+            predictedKeypoints, briefFeatures2, targetKeypoints, TYPICAL_SEARCH_RADIUS,
+            matchQualities);
+
+    EXPECT_EQ(correspondences, Correspondences({{0, 0}, {1, 1}}));
+    EXPECT_EQ(matchQualities, std::vector<float>({(float)core::NUM_BRIEF_BITS,
+            (float)TYPICAL_MIN_TOP_DISTANCE}));
+
+    // The global search can't tell the identical target feature vectors apart
+    EXPECT_TRUE(correspondenceFinder.execute(briefFeatures1, briefFeatures2).empty());
+}
+
 
 
 /**
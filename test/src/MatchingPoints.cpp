@@ -59,3 +59,21 @@ TEST(typicalMatchingPoints, corresInRange) {
             {{1, 0}, {0, 0}}));
 }
 
+/**
+ * Ensure that there must be exactly one quality score per correspondence.
+ */
+TEST(typicalMatchingPoints, qualities) {
+    const std::vector<cv::Point> keypoints1{{0, 0}, {0, 1}};
+    const std::vector<cv::Point> keypoints2{{0, 0}};
+
+    EXPECT_ANY_THROW(MatchingPoints(keypoints1, keypoints2,
+            {{0, 0}, {1, 0}}, {1.0f}));
+    EXPECT_ANY_THROW(MatchingPoints(keypoints1, keypoints2,
+            {}, {1.0f}));
+    EXPECT_NO_THROW(MatchingPoints(keypoints1, keypoints2,
+            {}, {}));
+
+    const MatchingPoints matchingPoints(keypoints1, keypoints2,
+            {{0, 0}, {1, 0}}, {1.0f, 2.0f});
+    EXPECT_EQ(matchingPoints.qualities, std::vector<float>({1.0f, 2.0f}));
+}
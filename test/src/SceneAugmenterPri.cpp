@@ -1,19 +1,43 @@
 #include "gtest/gtest.h"
 
+#include <stdexcept>
+
+#include "opencv2/imgcodecs.hpp"
+
 #include "SceneAugmenterPri.hpp"
 
 // Test-time params that control the number of scenarios tested
 static const cv::Size TYPICAL_IMAGE_SIZE(640, 480);
+static constexpr uint32_t NUM_BATCH_FRAMES = 6u;
+static constexpr uint32_t BATCH_QUEUE_DEPTH = 2u;
+static constexpr uint32_t NUM_ASYNC_THREADS = 3u;
+static constexpr uint32_t NUM_ASYNC_CALLS = 8u;
 
 // Valid, non-trivial feature model path
 static const std::string FEATURE_MODEL_PATH("test/assets/feature_models/valid.bin");
 
+// Image of a planar object, pasted into blank scene images at the given offset, and
+// the color of the replacement images used with it
+static const std::string SOURCE_IMAGE_PATH("test/assets/images/test.jpg");
+static const cv::Point SOURCE_OFFSET(120, 90);
+static const cv::Scalar REPLACEMENT_COLOR(0, 0, 255);
+static const cv::Scalar SECOND_REPLACEMENT_COLOR(128, 128, 128);
+// Max distance (in pixels) from the region augmented to the pasted source image
+static constexpr int32_t MAX_REGION_PADDING = 4;
+// Max distance (in pixels) from a located corner to the pasted source image corner
+static constexpr double MAX_CORNER_ERROR = 2.0;
+// Motion (in pixels) of the source object from one frame of a video to the next
+static const cv::Point FRAME_MOTION(3, 2);
+
 
 // Helper function headers
 void testInvalidInput(const cv::Mat& validImage, const cv::Mat& invalidImage);
 void validateAllCombinations(const cv::Mat& image1, const cv::Mat& image2);
 void testValidInput(const cv::Mat& sourceImage, const cv::Mat& replacementImage,
         const cv::Mat& targetImage);
+cv::Mat loadSourceImage();
+cv::Mat buildSceneImage(const cv::Mat& sourceImage, const cv::Point& offset);
+cv::Vec3b toPixel(const cv::Scalar& color);
 
 
 /**
@@ -54,6 +78,600 @@ TEST(simpleSceneAugmenter, invalidInputs) {
     testInvalidInput(validImage, cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC4));
 }
 
+/**
+ * Ensure caller-owned output images are reused, including the target image itself.
+ */
+TEST(simpleSceneAugmenter, outputImages) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(image);
+    sceneAugmenter.setReplacementImage(image);
+
+    // Output image of the right dimensions and type
+    cv::Mat outputImage = cv::Mat::ones(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    const uint8_t* outputData = outputImage.data;
+    sceneAugmenter.execute(image, outputImage);
+    EXPECT_EQ(outputImage.data, outputData);
+    EXPECT_EQ(cv::norm(outputImage, image, cv::NORM_INF), 0.0);
+
+    // Output image of the wrong type
+    cv::Mat grayOutputImage = cv::Mat::ones(TYPICAL_IMAGE_SIZE, CV_8UC1);
+    sceneAugmenter.execute(image, grayOutputImage);
+    EXPECT_EQ(grayOutputImage.type(), CV_8UC3);
+    EXPECT_EQ(grayOutputImage.size(), TYPICAL_IMAGE_SIZE);
+
+    // Target image itself
+    cv::Mat targetImage = image.clone();
+    const uint8_t* targetData = targetImage.data;
+    sceneAugmenter.execute(targetImage, targetImage);
+    EXPECT_EQ(targetImage.data, targetData);
+    EXPECT_EQ(cv::norm(targetImage, image, cv::NORM_INF), 0.0);
+}
+
+/**
+ * Ensure diagnostics report every stage of a call that finds the source object, and
+ * that the overloads writing into caller-owned output images report the same.
+ */
+TEST(typicalSceneAugmenter, diagnostics) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    sceneAugmenter.setReplacementImage(cv::Mat(sourceImage.size(), CV_8UC3,
+            REPLACEMENT_COLOR));
+    const cv::Mat targetImage = buildSceneImage(sourceImage, SOURCE_OFFSET);
+
+    SceneAugmenter::Diagnostics diagnostics;
+    sceneAugmenter.execute(targetImage, diagnostics);
+    EXPECT_GT(diagnostics.numSourceKeypoints, 0u);
+    EXPECT_GT(diagnostics.numTargetKeypoints, 0u);
+    EXPECT_GT(diagnostics.numCorrespondences, 0u);
+    EXPECT_EQ(diagnostics.numInstances, 1u);
+    EXPECT_GT(diagnostics.numInliers, 0u);
+    EXPECT_LE(diagnostics.numInliers, diagnostics.numCorrespondences);
+    EXPECT_FLOAT_EQ(diagnostics.inlierRatio,
+            (float)diagnostics.numInliers/(float)diagnostics.numCorrespondences);
+    EXPECT_GT(diagnostics.numIters, 0u);
+    EXPECT_LE(diagnostics.numIters, diagnostics.maxIters);
+    EXPECT_TRUE(diagnostics.isTransformationFound);
+    EXPECT_FALSE(diagnostics.isAugmentationRejected);
+    EXPECT_FALSE(diagnostics.isTracked);
+
+    // Stages run one after the other within the call
+    EXPECT_GE(diagnostics.targetDescriptionTimeMs, 0.0);
+    EXPECT_GE(diagnostics.correspondenceTimeMs, 0.0);
+    EXPECT_GE(diagnostics.fitTimeMs, 0.0);
+    EXPECT_GE(diagnostics.augmentationTimeMs, 0.0);
+    EXPECT_GT(diagnostics.totalTimeMs, 0.0);
+    EXPECT_LE(diagnostics.targetDescriptionTimeMs + diagnostics.correspondenceTimeMs +
+            diagnostics.fitTimeMs + diagnostics.augmentationTimeMs, diagnostics.totalTimeMs);
+
+    cv::Mat outputImage;
+    SceneAugmenter::Diagnostics outputDiagnostics;
+    sceneAugmenter.execute(targetImage, outputImage, outputDiagnostics);
+    EXPECT_EQ(outputDiagnostics.numTargetKeypoints, diagnostics.numTargetKeypoints);
+    EXPECT_EQ(outputDiagnostics.numCorrespondences, diagnostics.numCorrespondences);
+    EXPECT_EQ(outputDiagnostics.numInliers, diagnostics.numInliers);
+    EXPECT_EQ(outputDiagnostics.numIters, diagnostics.numIters);
+    EXPECT_TRUE(outputDiagnostics.isTransformationFound);
+    EXPECT_GT(outputDiagnostics.totalTimeMs, 0.0);
+
+    // Nothing to find in a blank image, the previous diagnostics are reset
+    sceneAugmenter.execute(cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3), outputImage,
+            outputDiagnostics);
+    EXPECT_EQ(outputDiagnostics.numTargetKeypoints, 0u);
+    EXPECT_EQ(outputDiagnostics.numCorrespondences, 0u);
+    EXPECT_EQ(outputDiagnostics.numInstances, 0u);
+    EXPECT_FALSE(outputDiagnostics.isTransformationFound);
+}
+
+/**
+ * Ensure overlays are empty when the source object is not found, and require the
+ * same images to be set as execute.
+ */
+TEST(simpleSceneAugmenter, overlay) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    SceneAugmenter::Overlay overlay;
+    EXPECT_ANY_THROW(sceneAugmenter.executeOverlay(image, overlay));
+    sceneAugmenter.setSourceImage(image);
+    sceneAugmenter.setReplacementImage(image);
+
+    SceneAugmenter::Diagnostics diagnostics;
+    sceneAugmenter.executeOverlay(image, overlay, diagnostics);
+    EXPECT_FALSE(diagnostics.isTransformationFound);
+    EXPECT_EQ(overlay.region.area(), 0);
+    EXPECT_TRUE(overlay.patch.empty());
+    EXPECT_TRUE(overlay.mask.empty());
+}
+
+/**
+ * Ensure the overlay of a found source object covers it with the replacement object,
+ * and composites onto the target image into the output of execute.
+ */
+TEST(typicalSceneAugmenter, overlay) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    sceneAugmenter.setReplacementImage(cv::Mat(sourceImage.size(), CV_8UC3,
+            REPLACEMENT_COLOR));
+    const cv::Mat targetImage = buildSceneImage(sourceImage, SOURCE_OFFSET);
+
+    SceneAugmenter::Overlay overlay;
+    SceneAugmenter::Diagnostics diagnostics;
+    sceneAugmenter.executeOverlay(targetImage, overlay, diagnostics);
+    ASSERT_TRUE(diagnostics.isTransformationFound);
+
+    // The region hugs the source object
+    const cv::Rect sourceRegion(SOURCE_OFFSET, sourceImage.size());
+    const cv::Rect paddedSourceRegion(sourceRegion.x - MAX_REGION_PADDING,
+            sourceRegion.y - MAX_REGION_PADDING, sourceRegion.width + 2*MAX_REGION_PADDING,
+            sourceRegion.height + 2*MAX_REGION_PADDING);
+    EXPECT_EQ(overlay.region & paddedSourceRegion, overlay.region);
+    EXPECT_GT(overlay.region.area(), 0);
+    ASSERT_EQ(overlay.patch.type(), CV_8UC3);
+    ASSERT_EQ(overlay.mask.type(), CV_8UC1);
+    EXPECT_EQ(overlay.patch.size(), overlay.region.size());
+    EXPECT_EQ(overlay.mask.size(), overlay.region.size());
+
+    // The replacement object is written over most of the source object
+    EXPECT_GT(cv::countNonZero(overlay.mask), sourceRegion.area()/2);
+    const cv::Point center = (sourceRegion.tl() + sourceRegion.br())/2 - overlay.region.tl();
+    EXPECT_EQ(overlay.mask.at<uint8_t>(center), 255);
+    EXPECT_EQ(overlay.patch.at<cv::Vec3b>(center), toPixel(REPLACEMENT_COLOR));
+
+    // Compositing the overlay gives the output of execute
+    cv::Mat compositedImage = targetImage.clone();
+    overlay.patch.copyTo(compositedImage(overlay.region), overlay.mask);
+    EXPECT_EQ(cv::norm(compositedImage, sceneAugmenter.execute(targetImage), cv::NORM_INF),
+            0.0);
+}
+
+/**
+ * Ensure locating the source object only requires the source image, and reports
+ * an invalid location when the source object is not found.
+ */
+TEST(simpleSceneAugmenter, locate) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    EXPECT_ANY_THROW(sceneAugmenter.locate(image));
+    sceneAugmenter.setSourceImage(image);
+
+    SceneAugmenter::Diagnostics diagnostics;
+    const SceneAugmenter::Location location = sceneAugmenter.locate(image, diagnostics);
+    EXPECT_FALSE(location.isValid);
+    EXPECT_TRUE(location.corners.empty());
+    EXPECT_EQ(location.numInliers, 0u);
+    EXPECT_FALSE(diagnostics.isTransformationFound);
+    EXPECT_EQ(diagnostics.augmentationTimeMs, 0.0);
+
+    std::vector<SceneAugmenter::Location> locations;
+    sceneAugmenter.locate(image, locations, diagnostics);
+    EXPECT_TRUE(locations.empty());
+}
+
+/**
+ * Ensure the location of a found source object maps its corners onto where it was
+ * pasted, without augmenting anything.
+ */
+TEST(typicalSceneAugmenter, locate) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    const cv::Mat targetImage = buildSceneImage(sourceImage, SOURCE_OFFSET);
+
+    SceneAugmenter::Diagnostics diagnostics;
+    const SceneAugmenter::Location location = sceneAugmenter.locate(targetImage, diagnostics);
+    ASSERT_TRUE(location.isValid);
+    EXPECT_GT(location.numInliers, 0u);
+    EXPECT_EQ(location.numInliers, diagnostics.numInliers);
+    EXPECT_EQ(diagnostics.augmentationTimeMs, 0.0);
+
+    const float width = (float)sourceImage.cols;
+    const float height = (float)sourceImage.rows;
+    const std::vector<cv::Point2f> sourceCorners{{0.0f, 0.0f}, {width, 0.0f},
+            {width, height}, {0.0f, height}};
+    const cv::Point2f offset((float)SOURCE_OFFSET.x, (float)SOURCE_OFFSET.y);
+    ASSERT_EQ(location.corners.size(), sourceCorners.size());
+    for (uint32_t iCorner = 0; iCorner < sourceCorners.size(); iCorner++) {
+        EXPECT_LE(cv::norm(location.corners[iCorner] - (sourceCorners[iCorner] + offset)),
+                MAX_CORNER_ERROR);
+
+        // The corners are the homography applied to the source image corners
+        const cv::Vec3f projectedCorner = location.homography*cv::Vec3f(
+                sourceCorners[iCorner].x, sourceCorners[iCorner].y, 1.0f);
+        const cv::Point2f mappedCorner(projectedCorner[0]/projectedCorner[2],
+                projectedCorner[1]/projectedCorner[2]);
+        EXPECT_LE(cv::norm(mappedCorner - location.corners[iCorner]), MAX_CORNER_ERROR);
+    }
+
+    std::vector<SceneAugmenter::Location> locations;
+    sceneAugmenter.locate(targetImage, locations, diagnostics);
+    ASSERT_EQ(locations.size(), 1u);
+    EXPECT_EQ(locations[0].corners, location.corners);
+}
+
+/**
+ * Ensure every replacement image produces its own output, from a single search.
+ */
+TEST(simpleSceneAugmenter, multipleReplacements) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    EXPECT_ANY_THROW(sceneAugmenter.setReplacementImages({}));
+    sceneAugmenter.setSourceImage(image);
+    sceneAugmenter.setReplacementImages({image, cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC1),
+            cv::Mat::ones(TYPICAL_IMAGE_SIZE, CV_8UC3)});
+
+    std::vector<cv::Mat> outputImages;
+    sceneAugmenter.execute(image, outputImages);
+    ASSERT_EQ(outputImages.size(), 3u);
+    for (const cv::Mat& outputImage : outputImages) {
+        EXPECT_EQ(outputImage.type(), CV_8UC3);
+        EXPECT_EQ(cv::norm(outputImage, image, cv::NORM_INF), 0.0);
+    }
+
+    std::vector<SceneAugmenter::Overlay> overlays;
+    sceneAugmenter.executeOverlay(image, overlays);
+    ASSERT_EQ(overlays.size(), 3u);
+    for (const SceneAugmenter::Overlay& overlay : overlays) {
+        EXPECT_EQ(overlay.region.area(), 0);
+    }
+
+    // Back to a single replacement image
+    sceneAugmenter.setReplacementImage(image);
+    sceneAugmenter.execute(image, outputImages);
+    EXPECT_EQ(outputImages.size(), 1u);
+}
+
+/**
+ * Ensure each output of a found source object is augmented with its own replacement
+ * image, and the first one matches the single output of execute.
+ */
+TEST(typicalSceneAugmenter, multipleReplacements) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    sceneAugmenter.setReplacementImages({
+            cv::Mat(sourceImage.size(), CV_8UC3, REPLACEMENT_COLOR),
+            cv::Mat(sourceImage.size(), CV_8UC1, SECOND_REPLACEMENT_COLOR)});
+    const cv::Mat targetImage = buildSceneImage(sourceImage, SOURCE_OFFSET);
+
+    std::vector<cv::Mat> outputImages;
+    SceneAugmenter::Diagnostics diagnostics;
+    sceneAugmenter.execute(targetImage, outputImages, diagnostics);
+    ASSERT_TRUE(diagnostics.isTransformationFound);
+    ASSERT_EQ(outputImages.size(), 2u);
+    const cv::Point center = SOURCE_OFFSET +
+            cv::Point(sourceImage.cols/2, sourceImage.rows/2);
+    EXPECT_EQ(outputImages[0].at<cv::Vec3b>(center), toPixel(REPLACEMENT_COLOR));
+    EXPECT_EQ(outputImages[1].at<cv::Vec3b>(center), toPixel(SECOND_REPLACEMENT_COLOR));
+    EXPECT_EQ(cv::norm(outputImages[0], sceneAugmenter.execute(targetImage), cv::NORM_INF),
+            0.0);
+
+    // Both overlays cover the same region, each with its own replacement image
+    std::vector<SceneAugmenter::Overlay> overlays;
+    sceneAugmenter.executeOverlay(targetImage, overlays);
+    ASSERT_EQ(overlays.size(), 2u);
+    ASSERT_GT(overlays[0].region.area(), 0);
+    EXPECT_EQ(overlays[1].region, overlays[0].region);
+    EXPECT_EQ(cv::norm(overlays[1].mask, overlays[0].mask, cv::NORM_INF), 0.0);
+    EXPECT_EQ(overlays[0].patch.at<cv::Vec3b>(center - overlays[0].region.tl()),
+            toPixel(REPLACEMENT_COLOR));
+    EXPECT_EQ(overlays[1].patch.at<cv::Vec3b>(center - overlays[1].region.tl()),
+            toPixel(SECOND_REPLACEMENT_COLOR));
+}
+
+/**
+ * Ensure the scene augmenter searches for at least one instance of the source object.
+ */
+TEST(simpleSceneAugmenter, invalidMaxNumInstances) {
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    EXPECT_ANY_THROW(sceneAugmenter.setMaxNumInstances(0u));
+    EXPECT_NO_THROW(sceneAugmenter.setMaxNumInstances(1u));
+}
+
+/**
+ * Ensure the warp cache tolerance of the scene augmenter can't be negative.
+ */
+TEST(simpleSceneAugmenter, invalidWarpCacheTolerance) {
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    EXPECT_ANY_THROW(sceneAugmenter.setWarpCacheTolerance(-1.0f));
+    EXPECT_NO_THROW(sceneAugmenter.setWarpCacheTolerance(0.0f));
+    EXPECT_NO_THROW(sceneAugmenter.setWarpCacheTolerance(2.5f));
+}
+
+/**
+ * Ensure the tracking params of the scene augmenter are validated.
+ */
+TEST(simpleSceneAugmenter, invalidTrackingParams) {
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    EXPECT_ANY_THROW(sceneAugmenter.setKeyframeInterval(0u));
+    EXPECT_NO_THROW(sceneAugmenter.setKeyframeInterval(1u));
+    EXPECT_ANY_THROW(sceneAugmenter.setMinTrackedInliers(3u));
+    EXPECT_NO_THROW(sceneAugmenter.setMinTrackedInliers(4u));
+}
+
+/**
+ * Ensure tracking mode searches the whole target image while there is nothing to
+ * track, and gives the same output as without it.
+ */
+TEST(simpleSceneAugmenter, tracking) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(image);
+    sceneAugmenter.setReplacementImage(image);
+    sceneAugmenter.setTrackingMode(true);
+    sceneAugmenter.setKeyframeInterval(3u);
+
+    SceneAugmenter::Diagnostics diagnostics;
+    for (uint32_t iFrame = 0; iFrame < 5u; iFrame++) {
+        const cv::Mat outputImage = sceneAugmenter.execute(image, diagnostics);
+        EXPECT_FALSE(diagnostics.isTracked);
+        EXPECT_FALSE(diagnostics.isTransformationFound);
+        EXPECT_EQ(cv::norm(outputImage, image, cv::NORM_INF), 0.0);
+    }
+
+    sceneAugmenter.setTrackingMode(false);
+    sceneAugmenter.execute(image, diagnostics);
+    EXPECT_FALSE(diagnostics.isTracked);
+}
+
+/**
+ * Ensure a source object moving across consecutive frames is tracked in between
+ * keyframes, only describing the target image around it.
+ */
+TEST(typicalSceneAugmenter, tracking) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    sceneAugmenter.setReplacementImage(cv::Mat(sourceImage.size(), CV_8UC3,
+            REPLACEMENT_COLOR));
+    sceneAugmenter.setTrackingMode(true);
+    sceneAugmenter.setKeyframeInterval(3u);
+
+    // Texture far from the source object, in the top left corner of every frame
+    const cv::Rect distractorRegion(0, 0, SOURCE_OFFSET.x/2, SOURCE_OFFSET.y/2);
+    cv::Mat distractorImage;
+    cv::flip(sourceImage(cv::Rect(cv::Point(0, 0), distractorRegion.size())),
+            distractorImage, -1);
+
+    uint32_t numKeyframeKeypoints = 0u;
+    for (uint32_t iFrame = 0; iFrame < 4u; iFrame++) {
+        const cv::Point offset = SOURCE_OFFSET + (int32_t)iFrame*FRAME_MOTION;
+        cv::Mat targetImage = buildSceneImage(sourceImage, offset);
+        distractorImage.copyTo(targetImage(distractorRegion));
+
+        SceneAugmenter::Diagnostics diagnostics;
+        const cv::Mat outputImage = sceneAugmenter.execute(targetImage, diagnostics);
+        EXPECT_TRUE(diagnostics.isTransformationFound);
+        const cv::Point center = offset + cv::Point(sourceImage.cols/2, sourceImage.rows/2);
+        EXPECT_EQ(outputImage.at<cv::Vec3b>(center), toPixel(REPLACEMENT_COLOR));
+
+        // Every third frame is a keyframe, the others only see keypoints near the
+        // source object
+        const bool isKeyframe = (iFrame % 3u == 0u);
+        EXPECT_EQ(diagnostics.isTracked, !isKeyframe);
+        if (isKeyframe) {
+            numKeyframeKeypoints = diagnostics.numTargetKeypoints;
+        } else {
+            EXPECT_LT(diagnostics.numTargetKeypoints, numKeyframeKeypoints);
+        }
+    }
+}
+
+/**
+ * Ensure batch execution writes every frame once, in order, the same as execute,
+ * and stops at the first error.
+ */
+TEST(simpleSceneAugmenter, batch) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(image);
+    EXPECT_ANY_THROW(sceneAugmenter.executeBatch(
+            [](uint32_t, cv::Mat&) { return false; }, [](uint32_t, const cv::Mat&) {},
+            BATCH_QUEUE_DEPTH));
+    sceneAugmenter.setReplacementImage(image);
+    EXPECT_ANY_THROW(sceneAugmenter.executeBatch(
+            [](uint32_t, cv::Mat&) { return false; }, [](uint32_t, const cv::Mat&) {}, 0u));
+
+    // Frames of distinct values
+    std::vector<uint32_t> writtenFrames;
+    sceneAugmenter.executeBatch(
+            [&](uint32_t iFrame, cv::Mat& targetImage) {
+                targetImage = cv::Mat(TYPICAL_IMAGE_SIZE, CV_8UC3, cv::Scalar::all(iFrame));
+                return iFrame < NUM_BATCH_FRAMES;
+            },
+            [&](uint32_t iFrame, const cv::Mat& outputImage) {
+                const cv::Mat targetImage(TYPICAL_IMAGE_SIZE, CV_8UC3, cv::Scalar::all(iFrame));
+                EXPECT_EQ(cv::norm(outputImage, sceneAugmenter.execute(targetImage),
+                        cv::NORM_INF), 0.0);
+                writtenFrames.push_back(iFrame);
+            },
+            BATCH_QUEUE_DEPTH);
+    ASSERT_EQ(writtenFrames.size(), NUM_BATCH_FRAMES);
+    for (uint32_t iFrame = 0; iFrame < NUM_BATCH_FRAMES; iFrame++) {
+        EXPECT_EQ(writtenFrames[iFrame], iFrame);
+    }
+
+    // Invalid frame in the middle of the stream
+    EXPECT_ANY_THROW(sceneAugmenter.executeBatch(
+            [&](uint32_t iFrame, cv::Mat& targetImage) {
+                targetImage = (iFrame == 1u) ? cv::Mat() : image;
+                return true;
+            },
+            [](uint32_t, const cv::Mat&) {}, BATCH_QUEUE_DEPTH));
+}
+
+/**
+ * Ensure batch execution augments the frames containing the source object the same
+ * as execute called in frame order, and writes them in that order.
+ */
+TEST(typicalSceneAugmenter, batch) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    const cv::Mat replacementImage(sourceImage.size(), CV_8UC3, REPLACEMENT_COLOR);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    sceneAugmenter.setReplacementImage(replacementImage);
+    SceneAugmenterPri referenceSceneAugmenter(FEATURE_MODEL_PATH);
+    referenceSceneAugmenter.setSourceImage(sourceImage);
+    referenceSceneAugmenter.setReplacementImage(replacementImage);
+
+    // The source object moves across the even frames and is absent from the odd ones
+    const std::function<cv::Mat(uint32_t)> buildFrame = [&](uint32_t iFrame) {
+        return (iFrame % 2u == 0u) ?
+                buildSceneImage(sourceImage, SOURCE_OFFSET + (int32_t)iFrame*FRAME_MOTION) :
+                cv::Mat(cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3));
+    };
+
+    std::vector<uint32_t> writtenFrames;
+    sceneAugmenter.executeBatch(
+            [&](uint32_t iFrame, cv::Mat& targetImage) {
+                targetImage = buildFrame(iFrame);
+                return iFrame < NUM_BATCH_FRAMES;
+            },
+            [&](uint32_t iFrame, const cv::Mat& outputImage) {
+                const cv::Mat targetImage = buildFrame(iFrame);
+                EXPECT_EQ(cv::norm(outputImage, referenceSceneAugmenter.execute(targetImage),
+                        cv::NORM_INF), 0.0);
+                EXPECT_EQ(cv::norm(outputImage, targetImage, cv::NORM_INF) > 0.0,
+                        iFrame % 2u == 0u);
+                writtenFrames.push_back(iFrame);
+            },
+            BATCH_QUEUE_DEPTH);
+    ASSERT_EQ(writtenFrames.size(), NUM_BATCH_FRAMES);
+    for (uint32_t iFrame = 0; iFrame < NUM_BATCH_FRAMES; iFrame++) {
+        EXPECT_EQ(writtenFrames[iFrame], iFrame);
+    }
+}
+
+/**
+ * Ensure asynchronous calls give the same output as execute, report their errors,
+ * and can be cancelled.
+ */
+TEST(simpleSceneAugmenter, async) {
+    const cv::Mat image = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    EXPECT_ANY_THROW(sceneAugmenter.setNumAsyncThreads(0u));
+    sceneAugmenter.setNumAsyncThreads(NUM_ASYNC_THREADS);
+    sceneAugmenter.setSourceImage(image);
+    sceneAugmenter.setReplacementImage(image);
+
+    // Future
+    std::vector<std::future<SceneAugmenter::AsyncResult>> futureResults;
+    for (uint32_t iCall = 0; iCall < NUM_ASYNC_CALLS; iCall++) {
+        futureResults.push_back(
+                sceneAugmenter.executeAsync(image, SceneAugmenter::CancellationToken()));
+    }
+    for (std::future<SceneAugmenter::AsyncResult>& futureResult : futureResults) {
+        const SceneAugmenter::AsyncResult result = futureResult.get();
+        EXPECT_FALSE(result.isCancelled);
+        EXPECT_FALSE(result.diagnostics.isTransformationFound);
+        EXPECT_EQ(cv::norm(result.outputImage, sceneAugmenter.execute(image),
+                cv::NORM_INF), 0.0);
+    }
+    EXPECT_ANY_THROW(sceneAugmenter.executeAsync(cv::Mat(),
+            SceneAugmenter::CancellationToken()).get());
+
+    // Callback
+    std::promise<SceneAugmenter::AsyncResult> resultPromise;
+    sceneAugmenter.executeAsync(cv::Mat(), [&](const SceneAugmenter::AsyncResult& result) {
+        resultPromise.set_value(result);
+    }, SceneAugmenter::CancellationToken());
+    const SceneAugmenter::AsyncResult errorResult = resultPromise.get_future().get();
+    EXPECT_TRUE(static_cast<bool>(errorResult.error));
+    EXPECT_TRUE(errorResult.outputImage.empty());
+
+    // Errors raised by the callback itself are ignored, and the pool keeps running
+    std::promise<void> throwPromise;
+    sceneAugmenter.executeAsync(image, [&](const SceneAugmenter::AsyncResult&) {
+        throwPromise.set_value();
+        throw std::runtime_error("Callback error");
+    }, SceneAugmenter::CancellationToken());
+    throwPromise.get_future().wait();
+    EXPECT_FALSE(sceneAugmenter.executeAsync(image,
+            SceneAugmenter::CancellationToken()).get().outputImage.empty());
+
+    // Cancelled before starting
+    const SceneAugmenter::CancellationToken cancellationToken;
+    cancellationToken.cancel();
+    const SceneAugmenter::AsyncResult cancelledResult =
+            sceneAugmenter.executeAsync(image, cancellationToken).get();
+    EXPECT_TRUE(cancelledResult.isCancelled);
+    EXPECT_TRUE(cancelledResult.outputImage.empty());
+}
+
+/**
+ * Ensure both scheduling policies give the same output, in the same order, on frames
+ * containing the source object.
+ */
+TEST(typicalSceneAugmenter, schedulingPolicy) {
+    const cv::Mat sourceImage = loadSourceImage();
+    ASSERT_FALSE(sourceImage.empty());
+    SceneAugmenterPri sceneAugmenter(FEATURE_MODEL_PATH);
+    sceneAugmenter.setSourceImage(sourceImage);
+    sceneAugmenter.setReplacementImage(cv::Mat(sourceImage.size(), CV_8UC3,
+            REPLACEMENT_COLOR));
+    const std::function<cv::Mat(uint32_t)> buildFrame = [&](uint32_t iFrame) {
+        return buildSceneImage(sourceImage, SOURCE_OFFSET + (int32_t)iFrame*FRAME_MOTION);
+    };
+
+    std::vector<std::vector<cv::Mat>> outputImages(2);
+    std::vector<std::vector<SceneAugmenter::Diagnostics>> outputDiagnostics(2);
+    const std::vector<SceneAugmenter::SchedulingPolicy> schedulingPolicies{
+            SceneAugmenter::SchedulingPolicy::LATENCY,
+            SceneAugmenter::SchedulingPolicy::THROUGHPUT};
+    for (uint32_t iPolicy = 0; iPolicy < schedulingPolicies.size(); iPolicy++) {
+        sceneAugmenter.setSchedulingPolicy(schedulingPolicies[iPolicy]);
+        sceneAugmenter.executeBatch(
+                [&](uint32_t iFrame, cv::Mat& targetImage) {
+                    targetImage = buildFrame(iFrame);
+                    return iFrame < NUM_BATCH_FRAMES;
+                },
+                [&](uint32_t iFrame, const cv::Mat& outputImage) {
+                    EXPECT_EQ(iFrame, outputImages[iPolicy].size());
+                    outputImages[iPolicy].push_back(outputImage.clone());
+                },
+                BATCH_QUEUE_DEPTH);
+
+        const SceneAugmenter::AsyncResult asyncResult = sceneAugmenter.executeAsync(
+                buildFrame(0u), SceneAugmenter::CancellationToken()).get();
+        outputImages[iPolicy].push_back(asyncResult.outputImage);
+        outputDiagnostics[iPolicy].push_back(asyncResult.diagnostics);
+
+        SceneAugmenter::Diagnostics diagnostics;
+        outputImages[iPolicy].push_back(sceneAugmenter.execute(buildFrame(1u), diagnostics));
+        outputDiagnostics[iPolicy].push_back(diagnostics);
+    }
+
+    // Every output is augmented, identically under both policies
+    ASSERT_EQ(outputImages[0].size(), NUM_BATCH_FRAMES + 2u);
+    ASSERT_EQ(outputImages[1].size(), outputImages[0].size());
+    for (uint32_t iImage = 0; iImage < outputImages[0].size(); iImage++) {
+        const cv::Mat targetImage = buildFrame((iImage < NUM_BATCH_FRAMES) ? iImage :
+                iImage - NUM_BATCH_FRAMES);
+        EXPECT_GT(cv::norm(outputImages[0][iImage], targetImage, cv::NORM_INF), 0.0);
+        EXPECT_EQ(cv::norm(outputImages[0][iImage], outputImages[1][iImage], cv::NORM_INF),
+                0.0);
+    }
+    for (uint32_t iCall = 0; iCall < outputDiagnostics[0].size(); iCall++) {
+        const SceneAugmenter::Diagnostics& latencyDiagnostics = outputDiagnostics[0][iCall];
+        const SceneAugmenter::Diagnostics& throughputDiagnostics =
+                outputDiagnostics[1][iCall];
+        EXPECT_TRUE(latencyDiagnostics.isTransformationFound);
+        EXPECT_EQ(throughputDiagnostics.numTargetKeypoints,
+                latencyDiagnostics.numTargetKeypoints);
+        EXPECT_EQ(throughputDiagnostics.numCorrespondences,
+                latencyDiagnostics.numCorrespondences);
+        EXPECT_EQ(throughputDiagnostics.numInliers, latencyDiagnostics.numInliers);
+        EXPECT_EQ(throughputDiagnostics.numIters, latencyDiagnostics.numIters);
+    }
+}
+
 /**
  * Ensure images of valid types are accepted by all public facing methods.
  */
@@ -82,12 +700,15 @@ void testInvalidInput(const cv::Mat& validImage, const cv::Mat& invalidImage) {
 
     EXPECT_ANY_THROW(sceneAugmenter.setSourceImage(invalidImage));
     EXPECT_ANY_THROW(sceneAugmenter.setReplacementImage(invalidImage));
+    EXPECT_ANY_THROW(sceneAugmenter.setReplacementImages({validImage, invalidImage}));
 
     // Set the source and replacement images with valid images so execute
     // fails specifically due to an invalid image
     sceneAugmenter.setSourceImage(validImage);
     sceneAugmenter.setReplacementImage(validImage);
     EXPECT_ANY_THROW(sceneAugmenter.execute(invalidImage));
+    SceneAugmenter::Overlay overlay;
+    EXPECT_ANY_THROW(sceneAugmenter.executeOverlay(invalidImage, overlay));
 }
 
 /**
@@ -116,5 +737,31 @@ void testValidInput(const cv::Mat& sourceImage, const cv::Mat& replacementImage,
     EXPECT_NO_THROW(sceneAugmenter.setSourceImage(sourceImage));
     EXPECT_NO_THROW(sceneAugmenter.setReplacementImage(replacementImage));
     EXPECT_NO_THROW(sceneAugmenter.execute(targetImage));
+    SceneAugmenter::Overlay overlay;
+    EXPECT_NO_THROW(sceneAugmenter.executeOverlay(targetImage, overlay));
+}
+
+/**
+ * Loads the image of the source object used by the typical tests.
+ */
+cv::Mat loadSourceImage() {
+    return cv::imread(SOURCE_IMAGE_PATH, cv::IMREAD_COLOR);
+}
+
+/**
+ * Builds a blank scene image of the typical dimensions with the source image pasted
+ * in it at the given offset.
+ */
+cv::Mat buildSceneImage(const cv::Mat& sourceImage, const cv::Point& offset) {
+    cv::Mat sceneImage = cv::Mat::zeros(TYPICAL_IMAGE_SIZE, CV_8UC3);
+    sourceImage.copyTo(sceneImage(cv::Rect(offset, sourceImage.size())));
+
+    return sceneImage;
 }
 
+/**
+ * Converts a color to the value of a 3-channel uint8 pixel.
+ */
+cv::Vec3b toPixel(const cv::Scalar& color) {
+    return cv::Vec3b((uint8_t)color[0], (uint8_t)color[1], (uint8_t)color[2]);
+}
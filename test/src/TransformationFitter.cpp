@@ -1,10 +1,31 @@
 #include "gtest/gtest.h"
 
+#include <omp.h>
+
 #include "TransformationFitter.hpp"
 
+// Test-time params that control the number of scenarios tested
+static constexpr int32_t GRID_SIDE = 10;
+static constexpr int32_t GRID_SPACING = 7;
+static constexpr uint32_t SMALL_MAX_ITERS = 500u;
+static constexpr uint64_t TYPICAL_SEED = 42u;
+static constexpr int32_t OUTLIER_STRIDE = 3;
+static const std::vector<int32_t> NUM_THREADS_TO_TEST{1, 2, 4, 7};
+static constexpr uint32_t NUM_RANKED_INLIERS = 20u;
+static constexpr uint32_t NUM_RANKED_OUTLIERS = 80u;
+static constexpr uint32_t NUM_CLUSTERED_INLIERS = 24u;
+static constexpr uint32_t NUM_SCATTERED_OUTLIERS = 200u;
+static constexpr float NOISY_EPSILON = 1.5f;
+static constexpr uint32_t MAX_NUM_INSTANCES = 3u;
+static const std::vector<uint32_t> ITERS_PER_BATCH_TO_TEST{1u, 5u,
+        TransformationFitter::MAX_ITERS_PER_BATCH};
+
 // Helper function headers
 bool isTransformationValid(const TransformationFitter& transformationFitter,
         const std::vector<cv::Point>& fromPts, const std::vector<cv::Point>& toPts);
+std::vector<cv::Point> buildGridPoints(const cv::Point& offset);
+MatchingPoints buildRankedMatches();
+MatchingPoints buildClusteredMatches();
 
 
 /**
@@ -77,6 +98,260 @@ TEST(typicalTransformationFitter, enoughInliers) {
             {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {2, 1}, {1, 2}, {2, 2}, {13, 13}}));
 }
 
+/**
+ * Ensures invalid params are rejected on construction.
+ */
+TEST(simpleTransformationFitter, invalidParams) {
+    TransformationFitter::Params params;
+
+    params.confidence = 0.0f;
+    EXPECT_ANY_THROW(TransformationFitter{params});
+    params.confidence = 1.5f;
+    EXPECT_ANY_THROW(TransformationFitter{params});
+    params.confidence = 1.0f;
+    EXPECT_NO_THROW(TransformationFitter{params});
+
+    params.napsacRadius = 0.0f;
+    EXPECT_ANY_THROW(TransformationFitter{params});
+    params.napsacRadius = 1.0f;
+
+    params.itersPerBatch = 0u;
+    EXPECT_ANY_THROW(TransformationFitter{params});
+    params.itersPerBatch = TransformationFitter::MAX_ITERS_PER_BATCH + 1u;
+    EXPECT_ANY_THROW(TransformationFitter{params});
+}
+
+/**
+ * Ensures the fit terminates well before the iteration cap when every matching
+ * point is an inlier, and that the reported statistics are consistent.
+ */
+TEST(typicalTransformationFitter, adaptiveTermination) {
+    const TransformationFitter transformationFitter;
+    const std::vector<cv::Point> fromPts = buildGridPoints({0, 0});
+    const std::vector<cv::Point> toPts = buildGridPoints({5, 3});
+
+    const TransformationFitter::FitResult fitResult =
+            transformationFitter.fit(MatchingPoints(fromPts, toPts));
+    EXPECT_TRUE(fitResult.transformation.isValid());
+    EXPECT_EQ(fitResult.numInliers, fromPts.size());
+    EXPECT_EQ(fitResult.numMatches, fromPts.size());
+    EXPECT_GT(fitResult.numIters, 0u);
+    EXPECT_EQ(fitResult.maxIters, TransformationFitter::Params{}.maxIters);
+    EXPECT_LT(fitResult.numIters, fitResult.maxIters);
+}
+
+/**
+ * Ensures the full iteration budget is spent when early termination is disabled.
+ */
+TEST(typicalTransformationFitter, fullConfidence) {
+    TransformationFitter::Params params;
+    params.maxIters = SMALL_MAX_ITERS;
+    params.confidence = 1.0f;
+    const TransformationFitter transformationFitter(params);
+    const std::vector<cv::Point> fromPts = buildGridPoints({0, 0});
+    const std::vector<cv::Point> toPts = buildGridPoints({5, 3});
+
+    const TransformationFitter::FitResult fitResult =
+            transformationFitter.fit(MatchingPoints(fromPts, toPts));
+    EXPECT_TRUE(fitResult.transformation.isValid());
+    EXPECT_EQ(fitResult.numIters, SMALL_MAX_ITERS);
+    EXPECT_EQ(fitResult.maxIters, SMALL_MAX_ITERS);
+}
+
+/**
+ * Ensures fits with a fixed seed are identical regardless of the number of threads.
+ */
+TEST(typicalTransformationFitter, reproducibleAcrossThreadCounts) {
+    TransformationFitter::Params params;
+    params.seed = TYPICAL_SEED;
+    const TransformationFitter transformationFitter(params);
+
+    // Corrupt every few matches so that the fit is not trivial
+    const std::vector<cv::Point> fromPts = buildGridPoints({0, 0});
+    std::vector<cv::Point> toPts = buildGridPoints({5, 3});
+    for (uint32_t iPt = 0; iPt < toPts.size(); iPt += OUTLIER_STRIDE) {
+        toPts[iPt] = {(int32_t)((iPt*37u) % 61u), (int32_t)((iPt*53u) % 67u)};
+    }
+    const MatchingPoints matches(fromPts, toPts);
+
+    const int32_t defaultNumThreads = omp_get_max_threads();
+    omp_set_num_threads(NUM_THREADS_TO_TEST.front());
+    const TransformationFitter::FitResult referenceResult = transformationFitter.fit(matches);
+    ASSERT_TRUE(referenceResult.transformation.isValid());
+
+    for (const int32_t numThreads : NUM_THREADS_TO_TEST) {
+        omp_set_num_threads(numThreads);
+        const TransformationFitter::FitResult fitResult = transformationFitter.fit(matches);
+        EXPECT_EQ(fitResult.numInliers, referenceResult.numInliers);
+        EXPECT_EQ(fitResult.numIters, referenceResult.numIters);
+        EXPECT_EQ(fitResult.transformation.apply(fromPts),
+                referenceResult.transformation.apply(fromPts));
+    }
+    omp_set_num_threads(defaultNumThreads);
+}
+
+/**
+ * Ensures PROSAC finds the fit and terminates much earlier than uniform sampling
+ * when the inliers are the best ranked matches.
+ */
+TEST(typicalTransformationFitter, prosacSampling) {
+    const MatchingPoints matches = buildRankedMatches();
+
+    TransformationFitter::Params params;
+    const TransformationFitter::FitResult uniformResult =
+            TransformationFitter(params).fit(matches);
+    params.sampler = TransformationFitter::Sampler::PROSAC;
+    const TransformationFitter::FitResult prosacResult =
+            TransformationFitter(params).fit(matches);
+
+    EXPECT_TRUE(uniformResult.transformation.isValid());
+    EXPECT_TRUE(prosacResult.transformation.isValid());
+    EXPECT_EQ(prosacResult.numInliers, NUM_RANKED_INLIERS);
+    EXPECT_LT(prosacResult.numIters, uniformResult.numIters);
+}
+
+/**
+ * Ensures NAPSAC finds the fit and terminates much earlier than uniform sampling
+ * when the inliers are clustered in a small region of the target image.
+ */
+TEST(typicalTransformationFitter, napsacSampling) {
+    const MatchingPoints matches = buildClusteredMatches();
+
+    TransformationFitter::Params params;
+    const TransformationFitter::FitResult uniformResult =
+            TransformationFitter(params).fit(matches);
+    params.sampler = TransformationFitter::Sampler::NAPSAC;
+    const TransformationFitter::FitResult napsacResult =
+            TransformationFitter(params).fit(matches);
+
+    EXPECT_TRUE(uniformResult.transformation.isValid());
+    EXPECT_TRUE(napsacResult.transformation.isValid());
+    EXPECT_EQ(napsacResult.numInliers, NUM_CLUSTERED_INLIERS);
+    EXPECT_LT(napsacResult.numIters, uniformResult.numIters);
+}
+
+/**
+ * Ensures the SPRT still finds the fit while verifying fewer matches per hypothesis,
+ * and that its adaptive decisions do not depend on the number of threads.
+ */
+TEST(typicalTransformationFitter, sprtEarlyRejection) {
+    const MatchingPoints matches = buildRankedMatches();
+
+    TransformationFitter::Params params;
+    params.seed = TYPICAL_SEED;
+    const TransformationFitter::FitResult plainResult =
+            TransformationFitter(params).fit(matches);
+    params.sprt = true;
+    const TransformationFitter transformationFitter(params);
+    const TransformationFitter::FitResult sprtResult = transformationFitter.fit(matches);
+
+    EXPECT_TRUE(plainResult.transformation.isValid());
+    EXPECT_TRUE(sprtResult.transformation.isValid());
+    EXPECT_EQ(sprtResult.numInliers, NUM_RANKED_INLIERS);
+    EXPECT_LT((double)sprtResult.numVerifications/(double)sprtResult.numIters,
+            (double)plainResult.numVerifications/(double)plainResult.numIters);
+
+    const int32_t defaultNumThreads = omp_get_max_threads();
+    for (const int32_t numThreads : NUM_THREADS_TO_TEST) {
+        omp_set_num_threads(numThreads);
+        const TransformationFitter::FitResult fitResult = transformationFitter.fit(matches);
+        EXPECT_EQ(fitResult.numIters, sprtResult.numIters);
+        EXPECT_EQ(fitResult.numVerifications, sprtResult.numVerifications);
+    }
+    omp_set_num_threads(defaultNumThreads);
+}
+
+/**
+ * Ensures evaluating hypotheses in batches selects the same best fit with the same
+ * inliers as evaluating them one at a time, with and without the SPRT.
+ */
+TEST(typicalTransformationFitter, batchedEvaluation) {
+    const MatchingPoints matches = buildRankedMatches();
+
+    for (const bool isSprt : {false, true}) {
+        TransformationFitter::Params params;
+        params.seed = TYPICAL_SEED;
+        params.sprt = isSprt;
+        params.itersPerBatch = 1u;
+        const TransformationFitter::FitResult referenceResult =
+                TransformationFitter(params).fit(matches);
+        ASSERT_TRUE(referenceResult.transformation.isValid());
+
+        for (const uint32_t itersPerBatch : ITERS_PER_BATCH_TO_TEST) {
+            params.itersPerBatch = itersPerBatch;
+            const TransformationFitter::FitResult fitResult =
+                    TransformationFitter(params).fit(matches);
+            EXPECT_EQ(fitResult.numInliers, referenceResult.numInliers);
+            EXPECT_EQ(fitResult.numIters, referenceResult.numIters);
+            EXPECT_EQ(fitResult.numVerifications, referenceResult.numVerifications);
+            EXPECT_EQ(fitResult.transformation.apply(matches.fromPts),
+                    referenceResult.transformation.apply(matches.fromPts));
+        }
+    }
+}
+
+/**
+ * Ensures local optimization recovers the inliers that hypotheses built from
+ * only 4 noisy matches miss.
+ */
+TEST(typicalTransformationFitter, localOptimization) {
+    // Translation with up to 1 pixel of noise along each axis
+    const std::vector<cv::Point> fromPts = buildGridPoints({0, 0});
+    std::vector<cv::Point> toPts = buildGridPoints({5, 3});
+    for (uint32_t iPt = 0; iPt < toPts.size(); iPt++) {
+        toPts[iPt] += cv::Point((int32_t)((iPt*7u) % 3u) - 1, (int32_t)((iPt*11u) % 3u) - 1);
+    }
+    const MatchingPoints matches(fromPts, toPts);
+
+    TransformationFitter::Params params;
+    params.seed = TYPICAL_SEED;
+    params.epsilon = NOISY_EPSILON;
+    const TransformationFitter::FitResult plainResult =
+            TransformationFitter(params).fit(matches);
+    params.localOptimization = true;
+    const TransformationFitter::FitResult loResult =
+            TransformationFitter(params).fit(matches);
+
+    EXPECT_TRUE(plainResult.transformation.isValid());
+    EXPECT_TRUE(loResult.transformation.isValid());
+    EXPECT_LT(plainResult.numInliers, fromPts.size());
+    EXPECT_EQ(loResult.numInliers, fromPts.size());
+}
+
+/**
+ * Ensures sequential fits find every instance of the source object, each with all
+ * of its own matches as inliers, and stop once no instance is left.
+ */
+TEST(typicalTransformationFitter, multipleInstances) {
+    const std::vector<cv::Point> gridPts = buildGridPoints({0, 0});
+    std::vector<cv::Point> fromPts = gridPts;
+    fromPts.insert(fromPts.end(), gridPts.cbegin(), gridPts.cend());
+    std::vector<cv::Point> toPts = buildGridPoints({5, 3});
+    const std::vector<cv::Point> secondInstancePts = buildGridPoints({200, 150});
+    toPts.insert(toPts.end(), secondInstancePts.cbegin(), secondInstancePts.cend());
+    const MatchingPoints matches(fromPts, toPts);
+
+    const TransformationFitter transformationFitter;
+    const std::vector<TransformationFitter::FitResult> fitResults =
+            transformationFitter.fitMultiple(matches, MAX_NUM_INSTANCES);
+    ASSERT_EQ(fitResults.size(), 2u);
+    for (const TransformationFitter::FitResult& fitResult : fitResults) {
+        EXPECT_TRUE(fitResult.transformation.isValid());
+        EXPECT_EQ(fitResult.numInliers, gridPts.size());
+    }
+    EXPECT_EQ(fitResults[1].numMatches, gridPts.size());
+    EXPECT_LT(fitResults[1].maxIters, fitResults[0].maxIters);
+
+    // Both instances are found, in any order
+    const std::vector<cv::Point> firstMappedPts = fitResults[0].transformation.apply(gridPts);
+    const std::vector<cv::Point> secondMappedPts = fitResults[1].transformation.apply(gridPts);
+    EXPECT_NE(firstMappedPts, secondMappedPts);
+    EXPECT_TRUE(firstMappedPts == secondInstancePts ||
+            secondMappedPts == secondInstancePts);
+
+    EXPECT_EQ(transformationFitter.fitMultiple(matches, 1u).size(), 1u);
+}
+
 /**
  * Helper function that builds a core::Transformation object and checks for validity.
  */
@@ -88,3 +363,61 @@ bool isTransformationValid(const TransformationFitter& transformationFitter,
     return transformation.isValid();
 }
 
+/**
+ * Helper function that builds a square grid of points shifted by the given offset.
+ */
+std::vector<cv::Point> buildGridPoints(const cv::Point& offset) {
+    std::vector<cv::Point> points;
+    for (int32_t iRow = 0; iRow < GRID_SIDE; iRow++) {
+        for (int32_t iCol = 0; iCol < GRID_SIDE; iCol++) {
+            points.emplace_back(offset.x + iCol*GRID_SPACING, offset.y + iRow*GRID_SPACING);
+        }
+    }
+
+    return points;
+}
+
+/**
+ * Helper function that builds matches where the best ranked ones are translated
+ * inliers and the rest are scattered outliers.
+ */
+MatchingPoints buildRankedMatches() {
+    std::vector<cv::Point> fromPts;
+    std::vector<cv::Point> toPts;
+    Correspondences correspondences;
+    std::vector<float> qualities;
+    for (uint32_t iPt = 0; iPt < NUM_RANKED_INLIERS + NUM_RANKED_OUTLIERS; iPt++) {
+        const cv::Point fromPt((int32_t)((iPt*17u) % 97u), (int32_t)((iPt*31u) % 89u));
+        const bool isInlier = (iPt < NUM_RANKED_INLIERS);
+        const cv::Point toPt = isInlier ? fromPt + cv::Point(5, 3) :
+                cv::Point((int32_t)((iPt*37u) % 211u) + 100, (int32_t)((iPt*41u) % 199u));
+
+        fromPts.push_back(fromPt);
+        toPts.push_back(toPt);
+        correspondences.emplace_back(iPt, iPt);
+        qualities.push_back(isInlier ? 100.0f - (float)iPt : 1.0f);
+    }
+
+    return MatchingPoints(fromPts, toPts, correspondences, qualities);
+}
+
+/**
+ * Helper function that builds matches where a small cluster of target points are
+ * inliers of a scale and translation, and the rest are outliers scattered over
+ * the full target image.
+ */
+MatchingPoints buildClusteredMatches() {
+    std::vector<cv::Point> fromPts;
+    std::vector<cv::Point> toPts;
+    for (uint32_t iPt = 0; iPt < NUM_CLUSTERED_INLIERS; iPt++) {
+        const cv::Point fromPt(5*(int32_t)((iPt*7u) % 40u), 5*(int32_t)((iPt*11u) % 37u));
+        fromPts.push_back(fromPt);
+        toPts.emplace_back(fromPt.x/5 + 300, fromPt.y/5 + 200);
+    }
+    for (uint32_t iPt = 0; iPt < NUM_SCATTERED_OUTLIERS; iPt++) {
+        fromPts.emplace_back((int32_t)((iPt*29u) % 200u), (int32_t)((iPt*43u) % 197u));
+        toPts.emplace_back((int32_t)((iPt*71u) % 640u), (int32_t)((iPt*59u) % 480u));
+    }
+
+    return MatchingPoints(fromPts, toPts);
+}
@@ -1,3 +1,5 @@
+#include <omp.h>
+
 #include "gtest/gtest.h"
 
 #include "core/Definitions.hpp"
@@ -7,6 +9,8 @@
 static constexpr int32_t TYPICAL_SIDE = 15;
 static constexpr int32_t MAX_DIM_SCALE = 3;
 static constexpr int32_t BOX_DIM_SCALE_MULT = 3;
+static constexpr int32_t DOT_SPACING = 8;
+static const std::vector<int32_t> NUM_THREADS_TO_TEST{1, 2, 4, 7};
 
 static const cv::Size typicalSize(TYPICAL_SIDE, TYPICAL_SIDE);
 
@@ -114,6 +118,41 @@ TEST(typicalImagesKeypointDetector, imagesWithLines) {
 
 }
 
+/** 
+ * Ensure keypoints come out in row-major order, whatever the number of threads.
+ */
+TEST(typicalImagesKeypointDetector, keypointOrder) {
+    const core::KeypointDetector keypointDetector;
+
+    // Draw a grid of dots
+    cv::Mat dotGrid = cv::Mat::zeros(MAX_DIM_SCALE*TYPICAL_SIDE,
+            MAX_DIM_SCALE*TYPICAL_SIDE, CV_32FC1);
+    for (int32_t iRow = DOT_SPACING; iRow < dotGrid.rows - DOT_SPACING; iRow += DOT_SPACING) {
+        for (int32_t iCol = DOT_SPACING; iCol < dotGrid.cols - DOT_SPACING;
+                iCol += DOT_SPACING) {
+            dotGrid.at<float>(iRow, iCol) = 1.0f;
+        }
+    }
+
+    const int32_t defaultNumThreads = omp_get_max_threads();
+    omp_set_num_threads(NUM_THREADS_TO_TEST.front());
+    const std::vector<cv::Point> keypoints = keypointDetector.execute(dotGrid);
+    ASSERT_GT(keypoints.size(), 1u);
+    for (uint32_t iPt = 1; iPt < keypoints.size(); iPt++) {
+        const cv::Point& prevKeypoint = keypoints[iPt - 1];
+        const cv::Point& keypoint = keypoints[iPt];
+        EXPECT_TRUE(prevKeypoint.y < keypoint.y ||
+                (prevKeypoint.y == keypoint.y && prevKeypoint.x < keypoint.x));
+    }
+
+    // The order does not depend on the number of threads
+    for (const int32_t numThreads : NUM_THREADS_TO_TEST) {
+        omp_set_num_threads(numThreads);
+        EXPECT_EQ(keypointDetector.execute(dotGrid), keypoints);
+    }
+    omp_set_num_threads(defaultNumThreads);
+}
+
 /**
  * Verify that running algorithm on the specified image has at least the specified
  * number of points.
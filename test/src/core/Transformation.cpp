@@ -9,6 +9,9 @@
 // Test-time params that control the number of scenarios tested
 static constexpr uint32_t NUM_BUILD_POINTS = core::homography::MIN_BUILD_POINTS;
 static constexpr uint32_t MAX_NUM_POINTS = NUM_BUILD_POINTS + 5;
+static constexpr double MAX_UINT8_AUGMENT_ERROR = 1.0;
+static constexpr float WARP_CACHE_TOLERANCE = 2.0f;
+static constexpr float MAX_CORNER_ERROR = 1e-3f;
 
 
 // Helper function headers
@@ -16,6 +19,8 @@ void validateFailure(const std::vector<cv::Point>& fromPoints,
         const std::vector<cv::Point>& toPoints);
 void validateSuccess(const std::vector<cv::Point>& fromPoints,
         const std::vector<cv::Point>& toPoints);
+static cv::Mat buildPatternImage(const cv::Size& size, int32_t phase);
+core::Transformation buildShiftedTransformation(int32_t shift);
 
 
 /**
@@ -130,6 +135,258 @@ TEST(simpleTransformation, simpleTransforms) {
             {{1, 1}, {3, 1}, {1, 3}, {5, 5}});
 }
 
+/**
+ * Verifies that transformations between image-sized shapes, where the
+ * coordinates span thousands of pixels, are estimated accurately.
+ */
+TEST(typicalTransformation, largeCoordinates) {
+    ASSERT_EQ(NUM_BUILD_POINTS, 4u);
+
+    // Perspective
+    validateSuccess(
+            {{0, 0}, {1919, 0}, {1919, 1079}, {0, 1079}},
+            {{103, 57}, {1787, 12}, {1850, 1001}, {40, 955}});
+    // Perspective + large translation
+    validateSuccess(
+            {{0, 0}, {639, 0}, {639, 479}, {0, 479}},
+            {{3021, 2240}, {3587, 2291}, {3602, 2730}, {2990, 2702}});
+
+    // Coordinates whose products overflow 32-bit integers
+    validateSuccess(
+            {{0, 0}, {60000, 0}, {60000, 60000}, {0, 60000}},
+            {{100, 100}, {60100, 100}, {60100, 60100}, {100, 60100}});
+    validateFailure(
+            {{0, 0}, {60000, 0}, {60000, 60000}, {0, 60000}},
+            {{0, 0}, {70000, 1}, {140000, 2}, {0, 60000}});
+}
+
+/**
+ * Verifies that least squares transformations require enough points and fit
+ * consistent matching points exactly.
+ */
+TEST(typicalTransformation, leastSquares) {
+    core::Transformation transformation;
+
+    std::vector<cv::Point> points;
+    for (uint32_t numPoints = 0; numPoints < NUM_BUILD_POINTS; numPoints++) {
+        EXPECT_ANY_THROW(transformation.buildLeastSquares(points, points));
+        points.emplace_back(numPoints, numPoints*numPoints);
+    }
+
+    // Affine map of a grid of points
+    const std::vector<cv::Point> fromPoints{{0, 0}, {50, 0}, {100, 0}, {0, 50}, {50, 50},
+            {100, 50}, {0, 100}, {50, 100}, {100, 100}};
+    const std::vector<cv::Point> toPoints{{10, 20}, {110, 30}, {210, 40}, {35, 70}, {135, 80},
+            {235, 90}, {60, 120}, {160, 130}, {260, 140}};
+    transformation.buildLeastSquares(fromPoints, toPoints);
+    EXPECT_TRUE(transformation.isValid());
+    EXPECT_EQ(transformation.apply(fromPoints), toPoints);
+}
+
+/**
+ * Verifies that augmentations are only sane for valid transformations that keep
+ * the replacement image orientation and land inside the target image.
+ */
+TEST(typicalTransformation, augmentationSanity) {
+    const cv::Size imageSize(100, 100);
+    core::Transformation transformation;
+    EXPECT_FALSE(transformation.isAugmentationSane(imageSize, imageSize));
+
+    // Scale + translation inside the target image
+    transformation.build({{0, 0}, {99, 0}, {99, 99}, {0, 99}},
+            {{10, 10}, {59, 10}, {59, 59}, {10, 59}});
+    ASSERT_TRUE(transformation.isValid());
+    EXPECT_TRUE(transformation.isAugmentationSane(imageSize, imageSize));
+
+    // Translation partially outside the target image
+    transformation.build({{0, 0}, {99, 0}, {99, 99}, {0, 99}},
+            {{50, 50}, {149, 50}, {149, 149}, {50, 149}});
+    ASSERT_TRUE(transformation.isValid());
+    EXPECT_FALSE(transformation.isAugmentationSane(imageSize, imageSize));
+}
+
+/**
+ * Verifies that augmentation replaces the region the replacement image lands on
+ * and leaves the rest of the target image untouched.
+ */
+TEST(typicalTransformation, augmentRegion) {
+    const cv::Mat targetImage = cv::Mat::zeros(100, 100, CV_32FC3);
+    const cv::Mat replacementImage(20, 20, CV_32FC3, cv::Scalar(0.5f, 0.5f, 0.5f));
+
+    // Translation inside the target image
+    core::Transformation transformation;
+    transformation.build({{0, 0}, {19, 0}, {19, 19}, {0, 19}},
+            {{40, 30}, {59, 30}, {59, 49}, {40, 49}});
+    ASSERT_TRUE(transformation.isValid());
+    const cv::Mat augmentedImage = transformation.augment(targetImage, replacementImage);
+    ASSERT_EQ(augmentedImage.size(), targetImage.size());
+
+    EXPECT_EQ(augmentedImage.at<cv::Vec3f>(31, 41), cv::Vec3f(0.5f, 0.5f, 0.5f));
+    EXPECT_EQ(augmentedImage.at<cv::Vec3f>(40, 50), cv::Vec3f(0.5f, 0.5f, 0.5f));
+    EXPECT_EQ(augmentedImage.at<cv::Vec3f>(48, 58), cv::Vec3f(0.5f, 0.5f, 0.5f));
+    EXPECT_EQ(augmentedImage.at<cv::Vec3f>(10, 10), cv::Vec3f(0.0f, 0.0f, 0.0f));
+    EXPECT_EQ(augmentedImage.at<cv::Vec3f>(40, 80), cv::Vec3f(0.0f, 0.0f, 0.0f));
+    EXPECT_EQ(augmentedImage.at<cv::Vec3f>(90, 50), cv::Vec3f(0.0f, 0.0f, 0.0f));
+}
+
+/**
+ * Verifies that augmenting uint8 images matches augmenting the same images in
+ * float32 within one unit of the least significant bit.
+ */
+TEST(typicalTransformation, augmentUint8MatchesFloat) {
+    const cv::Mat targetImage = buildPatternImage({200, 150}, 0);
+    const cv::Mat replacementImage = buildPatternImage({80, 60}, 1);
+
+    // Perspective
+    core::Transformation transformation;
+    transformation.build({{0, 0}, {79, 0}, {79, 59}, {0, 59}},
+            {{20, 15}, {170, 30}, {160, 140}, {30, 120}});
+    ASSERT_TRUE(transformation.isValid());
+
+    const cv::Mat augmentedImage = transformation.augment(targetImage, replacementImage);
+    ASSERT_EQ(augmentedImage.type(), CV_8UC3);
+    EXPECT_GT(cv::norm(augmentedImage, targetImage, cv::NORM_INF), 0.0);
+
+    cv::Mat targetImageFloat, replacementImageFloat;
+    targetImage.convertTo(targetImageFloat, CV_32FC3, 1.0/255.0);
+    replacementImage.convertTo(replacementImageFloat, CV_32FC3, 1.0/255.0);
+    const cv::Mat augmentedImageFloat = transformation.augment(
+            targetImageFloat, replacementImageFloat);
+    cv::Mat expectedImage;
+    augmentedImageFloat.convertTo(expectedImage, CV_8UC3, 255.0);
+    EXPECT_LE(cv::norm(augmentedImage, expectedImage, cv::NORM_INF), MAX_UINT8_AUGMENT_ERROR);
+}
+
+/**
+ * Verifies that replacement pyramids halve each level, and that heavily shrunk
+ * replacement images are sampled from the level as detailed as the instance.
+ */
+TEST(typicalTransformation, replacementPyramid) {
+    const cv::Mat replacementImage = buildPatternImage({64, 48}, 1);
+    const std::vector<cv::Mat> replacementPyramid =
+            core::Transformation::buildReplacementPyramid(replacementImage);
+    ASSERT_EQ(replacementPyramid.size(), 3u);
+    EXPECT_EQ(replacementPyramid[1].size(), cv::Size(32, 24));
+    EXPECT_EQ(replacementPyramid[2].size(), cv::Size(16, 12));
+
+    // Scale down by 4 along each side, as detailed as the coarsest level
+    const std::vector<cv::Point> toPoints{{20, 20}, {36, 20}, {36, 32}, {20, 32}};
+    core::Transformation transformation;
+    transformation.build({{0, 0}, {64, 0}, {64, 48}, {0, 48}}, toPoints);
+    ASSERT_TRUE(transformation.isValid());
+    const cv::Mat targetImage = cv::Mat::zeros(60, 60, CV_8UC3);
+    const cv::Mat augmentedImage = core::Transformation::augment(targetImage,
+            replacementPyramid, std::vector<core::Transformation>{transformation});
+
+    // Same placement sampled from each level on its own
+    std::vector<cv::Mat> levelImages;
+    for (const cv::Mat& levelImage : replacementPyramid) {
+        core::Transformation levelTransformation;
+        levelTransformation.build({{0, 0}, {levelImage.cols, 0},
+                {levelImage.cols, levelImage.rows}, {0, levelImage.rows}}, toPoints);
+        ASSERT_TRUE(levelTransformation.isValid());
+        levelImages.push_back(core::Transformation::augment(targetImage, {levelImage},
+                std::vector<core::Transformation>{levelTransformation}));
+    }
+
+    EXPECT_LE(cv::norm(augmentedImage, levelImages[2], cv::NORM_INF),
+            MAX_UINT8_AUGMENT_ERROR);
+    EXPECT_GT(cv::norm(augmentedImage, levelImages[1], cv::NORM_INF),
+            MAX_UINT8_AUGMENT_ERROR);
+    EXPECT_GT(cv::norm(augmentedImage, levelImages[0], cv::NORM_INF),
+            MAX_UINT8_AUGMENT_ERROR);
+    EXPECT_EQ(augmentedImage.at<cv::Vec3b>(10, 10), cv::Vec3b(0, 0, 0));
+}
+
+/**
+ * Verifies that the outer corners of an image are projected with sub-pixel precision.
+ */
+TEST(typicalTransformation, projectCorners) {
+    // Scale up by 2 and translate by (10, 5)
+    core::Transformation transformation;
+    transformation.build({{0, 0}, {10, 0}, {10, 10}, {0, 10}},
+            {{10, 5}, {30, 5}, {30, 25}, {10, 25}});
+    ASSERT_TRUE(transformation.isValid());
+
+    const std::vector<cv::Point2f> corners = transformation.projectCorners({7, 3});
+    const std::vector<cv::Point2f> expectedCorners{{10.0f, 5.0f}, {24.0f, 5.0f},
+            {24.0f, 11.0f}, {10.0f, 11.0f}};
+    ASSERT_EQ(corners.size(), expectedCorners.size());
+    for (uint32_t iCorner = 0; iCorner < corners.size(); iCorner++) {
+        EXPECT_NEAR(corners[iCorner].x, expectedCorners[iCorner].x, MAX_CORNER_ERROR);
+        EXPECT_NEAR(corners[iCorner].y, expectedCorners[iCorner].y, MAX_CORNER_ERROR);
+    }
+}
+
+/**
+ * Verifies that augmenting through a warp cache matches augmenting without one,
+ * and that the cached warp is reused while the instance moves within the tolerance
+ * of the cache and computed again once it moves further.
+ */
+TEST(typicalTransformation, warpCache) {
+    const cv::Mat targetImage = buildPatternImage({200, 150}, 0);
+    const std::vector<cv::Mat> replacementPyramid =
+            core::Transformation::buildReplacementPyramid(buildPatternImage({80, 60}, 1));
+    core::homography::Evaluator::WarpCache warpCache(WARP_CACHE_TOLERANCE);
+
+    // Same as without a cache when first built, and when reused as is
+    const std::vector<core::Transformation> transformations{buildShiftedTransformation(0)};
+    const cv::Mat expectedImage = core::Transformation::augment(targetImage,
+            replacementPyramid, transformations);
+    for (uint32_t iCall = 0; iCall < 2u; iCall++) {
+        cv::Mat augmentedImage = targetImage.clone();
+        ASSERT_TRUE(core::Transformation::augmentInPlace(augmentedImage, replacementPyramid,
+                transformations, &warpCache));
+        EXPECT_EQ(cv::norm(augmentedImage, expectedImage, cv::NORM_INF), 0.0);
+    }
+
+    // Moving within the tolerance keeps the cached warp
+    const std::vector<core::Transformation> nearTransformations{
+            buildShiftedTransformation((int32_t)WARP_CACHE_TOLERANCE - 1)};
+    cv::Mat augmentedImage = targetImage.clone();
+    core::Transformation::augmentInPlace(augmentedImage, replacementPyramid,
+            nearTransformations, &warpCache);
+    EXPECT_EQ(cv::norm(augmentedImage, expectedImage, cv::NORM_INF), 0.0);
+
+    // Moving further warps again
+    const std::vector<core::Transformation> farTransformations{
+            buildShiftedTransformation((int32_t)WARP_CACHE_TOLERANCE + 1)};
+    augmentedImage = targetImage.clone();
+    core::Transformation::augmentInPlace(augmentedImage, replacementPyramid,
+            farTransformations, &warpCache);
+    EXPECT_EQ(cv::norm(augmentedImage, core::Transformation::augment(targetImage,
+            replacementPyramid, farTransformations), cv::NORM_INF), 0.0);
+    EXPECT_GT(cv::norm(augmentedImage, expectedImage, cv::NORM_INF), 0.0);
+}
+
+/**
+ * Verifies that compositing a warp onto the target image through its coverage mask
+ * matches augmenting the target image, and that the warp is 0 outside of the mask.
+ */
+TEST(typicalTransformation, warpOverlay) {
+    const cv::Mat targetImage = buildPatternImage({200, 150}, 0);
+    const std::vector<cv::Mat> replacementPyramid =
+            core::Transformation::buildReplacementPyramid(buildPatternImage({80, 60}, 1));
+    const std::vector<core::Transformation> transformations{buildShiftedTransformation(0)};
+
+    core::homography::Evaluator::WarpCache warpCache;
+    ASSERT_TRUE(core::Transformation::warp(targetImage.size(), replacementPyramid,
+            transformations, warpCache));
+    ASSERT_GT(warpCache.region.area(), 0);
+    EXPECT_EQ(warpCache.warpedRegion.size(), warpCache.region.size());
+    EXPECT_EQ(warpCache.coverageMask.type(), CV_8UC1);
+
+    cv::Mat compositedImage = targetImage.clone();
+    cv::Mat compositedRegionImage = compositedImage(warpCache.region);
+    warpCache.warpedRegion.copyTo(compositedRegionImage, warpCache.coverageMask);
+    EXPECT_EQ(cv::norm(compositedImage, core::Transformation::augment(targetImage,
+            replacementPyramid, transformations), cv::NORM_INF), 0.0);
+
+    cv::Mat uncoveredMask;
+    cv::bitwise_not(warpCache.coverageMask, uncoveredMask);
+    EXPECT_EQ(cv::norm(warpCache.warpedRegion, cv::NORM_INF, uncoveredMask), 0.0);
+}
+
 /**
  * Verifies that the given matching points produces an invalid
  * core::Transformation object and such object behaves properly.
@@ -161,3 +418,30 @@ void validateSuccess(const std::vector<cv::Point>& fromPoints,
     EXPECT_EQ(transformedFromPoints, toPoints);
 }
 
+/**
+ * Builds a color image filled with a deterministic pattern of varying pixel values.
+ */
+static cv::Mat buildPatternImage(const cv::Size& size, int32_t phase) {
+    cv::Mat image(size, CV_8UC3);
+    for (int32_t y = 0; y < size.height; y++) {
+        for (int32_t x = 0; x < size.width; x++) {
+            image.at<cv::Vec3b>(y, x) = cv::Vec3b((uint8_t)((7*x + 3*y + phase) % 256),
+                    (uint8_t)((x*x + 5*y + 11*phase) % 256),
+                    (uint8_t)((x + y*y + 29*phase) % 256));
+        }
+    }
+
+    return image;
+}
+
+/**
+ * Builds a perspective transformation of an 80x60 image, shifted to the right by
+ * the given number of pixels.
+ */
+core::Transformation buildShiftedTransformation(int32_t shift) {
+    core::Transformation transformation;
+    transformation.build({{0, 0}, {79, 0}, {79, 59}, {0, 59}},
+            {{20 + shift, 15}, {170 + shift, 30}, {160 + shift, 140}, {30 + shift, 120}});
+
+    return transformation;
+}
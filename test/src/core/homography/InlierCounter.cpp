@@ -0,0 +1,88 @@
+#include "gtest/gtest.h"
+
+#include "opencv2/core.hpp"
+
+#include "core/homography/Definitions.hpp"
+#include "core/homography/InlierCounter.hpp"
+
+using core::homography::InlierCounter;
+
+// Test-time params that control the number of scenarios tested
+static constexpr uint32_t MAX_NUM_POINTS = 3*InlierCounter::BLOCK_SIZE + 1;
+static constexpr float TYPICAL_EPSILON = 3.0f;
+
+// Helper function headers
+std::vector<cv::Point> buildPoints(uint32_t numPoints);
+bool isInlier(const std::vector<uint8_t>& inlierMask, uint32_t iPt);
+
+
+/**
+ * Ensures the coordinates are padded to a whole number of blocks, and that padding
+ * is never counted as consistent.
+ */
+TEST(simpleInlierCounter, padding) {
+    const core::homography::Homography identity(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f);
+    for (uint32_t numPoints = 0; numPoints <= MAX_NUM_POINTS; numPoints++) {
+        const std::vector<cv::Point> points = buildPoints(numPoints);
+        const InlierCounter::MatchCoordinates matchCoordinates =
+                InlierCounter::buildMatchCoordinates(points, points);
+
+        EXPECT_EQ(matchCoordinates.numPoints, numPoints);
+        EXPECT_EQ(matchCoordinates.fromXs.size() % InlierCounter::BLOCK_SIZE, 0u);
+        EXPECT_LT(matchCoordinates.fromXs.size(), numPoints + InlierCounter::BLOCK_SIZE);
+        EXPECT_EQ(InlierCounter::countInliers(matchCoordinates, identity, TYPICAL_EPSILON),
+                numPoints);
+    }
+}
+
+/**
+ * Ensures the count and the inlier mask agree with the distance of each mapped
+ * point to its target.
+ */
+TEST(typicalInlierCounter, countAndMask) {
+    // Translation by (5, 3)
+    const core::homography::Homography translation(1.0f, 0.0f, 5.0f, 0.0f, 1.0f, 3.0f,
+            0.0f, 0.0f, 1.0f);
+    const std::vector<cv::Point> fromPts = buildPoints(MAX_NUM_POINTS);
+    std::vector<cv::Point> toPts;
+    for (uint32_t iPt = 0; iPt < fromPts.size(); iPt++) {
+        // Shift targets by a growing amount, only the first few stay within epsilon
+        toPts.push_back(fromPts[iPt] + cv::Point(5 + (int32_t)(iPt % 5), 3));
+    }
+    const InlierCounter::MatchCoordinates matchCoordinates =
+            InlierCounter::buildMatchCoordinates(fromPts, toPts);
+
+    std::vector<uint8_t> inlierMask;
+    const uint32_t numInliers = InlierCounter::countInliers(matchCoordinates, translation,
+            TYPICAL_EPSILON, &inlierMask);
+    ASSERT_EQ(inlierMask.size(), InlierCounter::getNumBlocks(matchCoordinates));
+
+    uint32_t expectedNumInliers = 0u;
+    for (uint32_t iPt = 0; iPt < fromPts.size(); iPt++) {
+        const bool expectedIsInlier = ((float)(iPt % 5) < TYPICAL_EPSILON);
+        EXPECT_EQ(isInlier(inlierMask, iPt), expectedIsInlier);
+        expectedNumInliers += expectedIsInlier ? 1u : 0u;
+    }
+    EXPECT_EQ(numInliers, expectedNumInliers);
+}
+
+/**
+ * Helper function that builds a list of distinct points.
+ */
+std::vector<cv::Point> buildPoints(uint32_t numPoints) {
+    std::vector<cv::Point> points;
+    for (uint32_t iPt = 0; iPt < numPoints; iPt++) {
+        points.emplace_back((int32_t)((iPt*17u) % 97u), (int32_t)((iPt*31u) % 89u));
+    }
+
+    return points;
+}
+
+/**
+ * Helper function that checks the bit of a point in an inlier mask.
+ */
+bool isInlier(const std::vector<uint8_t>& inlierMask, uint32_t iPt) {
+    const uint8_t blockMask = inlierMask[iPt/InlierCounter::BLOCK_SIZE];
+    return ((blockMask >> (iPt % InlierCounter::BLOCK_SIZE)) & 1u) != 0u;
+}
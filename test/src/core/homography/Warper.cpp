@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+
+#include "opencv2/core.hpp"
+
+#include "core/homography/Definitions.hpp"
+#include "core/homography/Warper.hpp"
+
+using core::homography::Warper;
+
+// Test-time params that control the number of scenarios tested
+static constexpr int32_t MAX_REGION_WIDTH = 3*Warper::BLOCK_SIZE + 1;
+static constexpr float MAX_MAPPING_ERROR = 1e-3f;
+
+// Helper function headers
+static cv::Mat buildChannelPatternImage(const cv::Size& size);
+
+
+/**
+ * Ensures stepping the projections along each row agrees with projecting every
+ * pixel, including over the partial block at the end of a row.
+ */
+TEST(simpleWarper, mapRegion) {
+    // Downscaling by 2 about a quarter pixel, so no pixel maps onto a boundary
+    const core::homography::Homography inverseHomography(0.5f, 0.0f, -0.125f, 0.0f, 0.5f,
+            -0.125f, 0.0f, 0.0f, 1.0f);
+    const cv::Size replacementSize(7, 5);
+    for (int32_t width = 1; width <= MAX_REGION_WIDTH; width++) {
+        cv::Mat mapXs(3, width, CV_32FC1);
+        cv::Mat mapYs(3, width, CV_32FC1);
+        Warper::mapRegion({inverseHomography}, replacementSize, mapXs, mapYs);
+
+        for (int32_t y = 0; y < mapXs.rows; y++) {
+            for (int32_t x = 0; x < width; x++) {
+                const float expectedX = 0.5f*x - 0.125f;
+                const float expectedY = 0.5f*y - 0.125f;
+                if (expectedX < (float)replacementSize.width &&
+                        expectedY < (float)replacementSize.height) {
+                    EXPECT_NEAR(mapXs.at<float>(y, x), expectedX, MAX_MAPPING_ERROR);
+                    EXPECT_NEAR(mapYs.at<float>(y, x), expectedY, MAX_MAPPING_ERROR);
+                } else {
+                    EXPECT_LT(mapXs.at<float>(y, x), -1.0f);
+                    EXPECT_LT(mapYs.at<float>(y, x), -1.0f);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Ensures warping through the identity copies the replacement image exactly, down
+ * to its last pixel, and leaves the rest of the region untouched.
+ */
+TEST(typicalWarper, warpUint8Identity) {
+    const core::homography::Homography identity(1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 1.0f);
+    const cv::Mat replacementImage =
+            buildChannelPatternImage(cv::Size(MAX_REGION_WIDTH - 4, 11));
+    const cv::Scalar targetColor(10, 20, 30);
+    cv::Mat regionImage(cv::Size(MAX_REGION_WIDTH, 13), CV_8UC3, targetColor);
+    Warper::warpUint8(replacementImage, {identity}, regionImage);
+
+    const cv::Rect replacementRect(cv::Point(0, 0), replacementImage.size());
+    EXPECT_EQ(cv::norm(regionImage(replacementRect), replacementImage, cv::NORM_INF), 0.0);
+
+    cv::Mat untouchedMask(regionImage.size(), CV_8UC1, cv::Scalar(255));
+    untouchedMask(replacementRect).setTo(0);
+    cv::Mat expectedImage(regionImage.size(), CV_8UC3, targetColor);
+    EXPECT_EQ(cv::norm(regionImage, expectedImage, cv::NORM_INF, untouchedMask), 0.0);
+}
+
+/**
+ * Helper function that builds a uint8 color image with distinct channels.
+ */
+static cv::Mat buildChannelPatternImage(const cv::Size& size) {
+    cv::Mat image(size, CV_8UC3);
+    for (int32_t y = 0; y < size.height; y++) {
+        for (int32_t x = 0; x < size.width; x++) {
+            image.at<cv::Vec3b>(y, x) = cv::Vec3b((uint8_t)(17*x + 5*y),
+                    (uint8_t)(40 + 3*x*y), (uint8_t)(255 - 9*y));
+        }
+    }
+
+    return image;
+}
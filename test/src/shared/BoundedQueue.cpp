@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "shared/BoundedQueue.hpp"
+
+// Test-time params that control the number of scenarios tested
+static constexpr uint32_t TYPICAL_CAPACITY = 4u;
+static constexpr uint32_t NUM_ELEMENTS = 100000u;
+static constexpr uint32_t WAKE_DELAY_MS = 50u;
+
+
+/**
+ * Ensure the queue holds up to its capacity, and gives its elements back in order.
+ */
+TEST(simpleBoundedQueue, capacity) {
+    EXPECT_ANY_THROW(shared::BoundedQueue<uint32_t>(0u));
+
+    shared::BoundedQueue<uint32_t> queue(TYPICAL_CAPACITY);
+    uint32_t value = 0u;
+    EXPECT_FALSE(queue.tryPop(value));
+
+    for (uint32_t iElement = 0; iElement < TYPICAL_CAPACITY; iElement++) {
+        value = iElement;
+        EXPECT_TRUE(queue.tryPush(value));
+    }
+    value = TYPICAL_CAPACITY;
+    EXPECT_FALSE(queue.tryPush(value));
+
+    // Wrap around the ring of slots
+    for (uint32_t iElement = 0; iElement < 2u*TYPICAL_CAPACITY; iElement++) {
+        ASSERT_TRUE(queue.tryPop(value));
+        EXPECT_EQ(value, iElement);
+        value = iElement + TYPICAL_CAPACITY;
+        EXPECT_TRUE(queue.tryPush(value));
+    }
+}
+
+/**
+ * Ensure waiting on a queue stops once cancelled.
+ */
+TEST(simpleBoundedQueue, cancellation) {
+    shared::BoundedQueue<uint32_t> queue(1u);
+    const std::atomic<bool> isCancelled(true);
+
+    uint32_t value = 0u;
+    EXPECT_FALSE(queue.pop(value, isCancelled));
+    EXPECT_TRUE(queue.push(value, isCancelled));
+    EXPECT_FALSE(queue.push(value, isCancelled));
+}
+
+/**
+ * Ensure a thread blocked on an empty queue is woken by the next element pushed, and
+ * one blocked on a full queue by the next element popped.
+ */
+TEST(typicalBoundedQueue, blockingWake) {
+    shared::BoundedQueue<uint32_t> queue(1u);
+    const std::atomic<bool> isCancelled(false);
+
+    std::thread producer([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAKE_DELAY_MS));
+        uint32_t value = 1u;
+        queue.push(value, isCancelled);
+        value = 2u;
+        queue.push(value, isCancelled);
+        value = 3u;
+        queue.push(value, isCancelled);
+    });
+
+    uint32_t value = 0u;
+    ASSERT_TRUE(queue.pop(value, isCancelled));
+    EXPECT_EQ(value, 1u);
+    std::this_thread::sleep_for(std::chrono::milliseconds(WAKE_DELAY_MS));
+    ASSERT_TRUE(queue.pop(value, isCancelled));
+    EXPECT_EQ(value, 2u);
+    ASSERT_TRUE(queue.pop(value, isCancelled));
+    EXPECT_EQ(value, 3u);
+    producer.join();
+}
+
+/**
+ * Ensure a thread blocked on a queue stops waiting once cancelled from another thread.
+ */
+TEST(typicalBoundedQueue, blockingCancellation) {
+    shared::BoundedQueue<uint32_t> queue(1u);
+    std::atomic<bool> isCancelled(false);
+
+    std::thread canceller([&]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(WAKE_DELAY_MS));
+        isCancelled = true;
+        queue.wakeAll();
+    });
+
+    uint32_t value = 0u;
+    EXPECT_FALSE(queue.pop(value, isCancelled));
+    canceller.join();
+}
+
+/**
+ * Ensure every element pushed by a producer thread reaches a consumer thread once,
+ * in order.
+ */
+TEST(typicalBoundedQueue, producerConsumer) {
+    shared::BoundedQueue<uint32_t> queue(TYPICAL_CAPACITY);
+    const std::atomic<bool> isCancelled(false);
+
+    std::thread producer([&]() {
+        for (uint32_t iElement = 0; iElement < NUM_ELEMENTS; iElement++) {
+            uint32_t value = iElement;
+            queue.push(value, isCancelled);
+        }
+    });
+
+    std::vector<uint32_t> values;
+    for (uint32_t iElement = 0; iElement < NUM_ELEMENTS; iElement++) {
+        uint32_t value = 0u;
+        queue.pop(value, isCancelled);
+        values.push_back(value);
+    }
+    producer.join();
+
+    for (uint32_t iElement = 0; iElement < NUM_ELEMENTS; iElement++) {
+        ASSERT_EQ(values[iElement], iElement);
+    }
+}
@@ -0,0 +1,73 @@
+#include "gtest/gtest.h"
+
+#include <set>
+#include <vector>
+
+#include "shared/RandomNumberGenerator.hpp"
+
+// Test-time params that control the number of scenarios tested
+static constexpr uint64_t TYPICAL_SEED = 1234u;
+static constexpr uint32_t NUM_STREAMS = 100u;
+static constexpr uint32_t NUM_DRAWS = 1000u;
+static constexpr uint32_t NUM_SAMPLED_VALUES = 4u;
+
+
+/**
+ * Ensure that a stream is fully determined by its seed and stream index.
+ */
+TEST(simpleRandomNumberGenerator, reproducibleStreams) {
+    for (uint32_t iStream = 0; iStream < NUM_STREAMS; iStream++) {
+        shared::RandomNumberGenerator rng1(TYPICAL_SEED, iStream);
+        shared::RandomNumberGenerator rng2(TYPICAL_SEED, iStream);
+        for (uint32_t iDraw = 0; iDraw < NUM_DRAWS; iDraw++) {
+            EXPECT_EQ(rng1.next(), rng2.next());
+        }
+    }
+}
+
+/**
+ * Ensure that different seeds and different streams produce different values.
+ */
+TEST(simpleRandomNumberGenerator, distinctStreams) {
+    std::set<uint64_t> firstValues;
+    for (uint32_t iStream = 0; iStream < NUM_STREAMS; iStream++) {
+        firstValues.insert(shared::RandomNumberGenerator(TYPICAL_SEED, iStream).next());
+        firstValues.insert(shared::RandomNumberGenerator(TYPICAL_SEED + 1u, iStream).next());
+    }
+
+    EXPECT_EQ(firstValues.size(), 2u*NUM_STREAMS);
+}
+
+/**
+ * Ensure that bounded integers stay in range and cover the full range.
+ */
+TEST(typicalRandomNumberGenerator, uniformInRange) {
+    for (uint32_t bound = 1u; bound < NUM_STREAMS; bound++) {
+        shared::RandomNumberGenerator rng(TYPICAL_SEED, bound);
+        std::set<uint32_t> values;
+        for (uint32_t iDraw = 0; iDraw < NUM_DRAWS; iDraw++) {
+            const uint32_t value = rng.uniform(bound);
+            EXPECT_LT(value, bound);
+            values.insert(value);
+        }
+        EXPECT_EQ(values.size(), bound);
+    }
+}
+
+/**
+ * Ensure that sampling without replacement never repeats a value, even when the
+ * number of values drawn equals the range.
+ */
+TEST(typicalRandomNumberGenerator, sampleDistinct) {
+    for (uint32_t bound = NUM_SAMPLED_VALUES; bound < NUM_STREAMS; bound++) {
+        shared::RandomNumberGenerator rng(TYPICAL_SEED, bound);
+        for (uint32_t iDraw = 0; iDraw < NUM_DRAWS; iDraw++) {
+            uint32_t values[NUM_SAMPLED_VALUES];
+            rng.sampleDistinct(bound, NUM_SAMPLED_VALUES, values);
+
+            const std::set<uint32_t> uniqueValues(values, values + NUM_SAMPLED_VALUES);
+            EXPECT_EQ(uniqueValues.size(), NUM_SAMPLED_VALUES);
+            EXPECT_LT(*uniqueValues.rbegin(), bound);
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "shared/ThreadPool.hpp"
+
+// Test-time params that control the number of scenarios tested
+static constexpr uint32_t TYPICAL_NUM_THREADS = 4u;
+static constexpr uint32_t NUM_TASKS = 1000u;
+
+
+/**
+ * Ensure the pool has at least one thread.
+ */
+TEST(simpleThreadPool, numThreads) {
+    EXPECT_ANY_THROW(shared::ThreadPool(0u));
+    EXPECT_EQ(shared::ThreadPool(TYPICAL_NUM_THREADS).getNumThreads(), TYPICAL_NUM_THREADS);
+}
+
+/**
+ * Ensure every task submitted runs once, including the ones still pending when the
+ * pool is destroyed.
+ */
+TEST(typicalThreadPool, allTasksRun) {
+    std::atomic<uint32_t> numTasksRun(0u);
+    {
+        shared::ThreadPool threadPool(TYPICAL_NUM_THREADS);
+        for (uint32_t iTask = 0; iTask < NUM_TASKS; iTask++) {
+            threadPool.submit([&numTasksRun]() {
+                std::this_thread::sleep_for(std::chrono::microseconds(10));
+                numTasksRun++;
+            });
+        }
+    }
+
+    EXPECT_EQ(numTasksRun.load(), NUM_TASKS);
+}
+
+/**
+ * Ensure tasks run concurrently on the threads of the pool.
+ */
+TEST(typicalThreadPool, concurrentTasks) {
+    std::atomic<uint32_t> numTasksStarted(0u);
+    std::atomic<uint32_t> numTasksConcurrent(0u);
+    {
+        shared::ThreadPool threadPool(TYPICAL_NUM_THREADS);
+        for (uint32_t iTask = 0; iTask < TYPICAL_NUM_THREADS; iTask++) {
+            // Each task waits (up to a timeout) for all of them to have started
+            threadPool.submit([&]() {
+                numTasksStarted++;
+                const std::chrono::steady_clock::time_point startTime =
+                        std::chrono::steady_clock::now();
+                while (numTasksStarted.load() < TYPICAL_NUM_THREADS &&
+                        std::chrono::steady_clock::now() - startTime < std::chrono::seconds(10)) {
+                    std::this_thread::yield();
+                }
+
+                if (numTasksStarted.load() == TYPICAL_NUM_THREADS) {
+                    numTasksConcurrent++;
+                }
+            });
+        }
+    }
+
+    EXPECT_EQ(numTasksConcurrent.load(), TYPICAL_NUM_THREADS);
+}